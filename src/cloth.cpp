@@ -10,13 +10,24 @@
 #include <cassert>
 #include <cstdio>
 #include <cmath>
+#include <cfloat>
 #include <cstring>
 #include <algorithm>
+#include <vector>
+#include <queue>
+#include <new>
 
 #include <GL/glew.h>
 #include <GL/gl.h>
 
 #include "cloth.hpp"
+#include "thread_pool.hpp"
+#include "multigrid.hpp"
+#include "implicit_solver.hpp"
+#include "projective_solver.hpp"
+#include "tile_sleep.hpp"
+#include "self_collision.hpp"
+#include "simd/springs.hpp"
 
 
 const char* gl_error_str(GLenum error)
@@ -55,11 +66,42 @@ const char* gl_error_str(GLenum error)
     } while(false)
 
 
-Cloth::Cloth(float width, float height, size_t rows, size_t cols, const World &world)
-    : m_prev_dt(-1.0f)
+Cloth::Cloth(float width, float height, size_t rows, size_t cols, const World &world,
+             PrevStorage prev_storage)
+    : m_arena(arena_size(rows, cols, prev_storage))
+    , m_prev_storage(prev_storage)
+    , m_pins_dirty(true)
+    , m_prev_dt(-1.0f)
+    , m_substeps(1)
     , m_gravity(glm::vec3(0.0f, -0.9f, 0.0f))
+    , m_integrator(INTEGRATOR_VERLET)
+    , m_spring_solver(SPRING_SOLVER_JACOBI)
+    , m_spring_min_iterations(4)
+    , m_spring_max_iterations(4)
+    , m_spring_tolerance(0.0f)
+    , m_chebyshev_rho(0.0f)
+    , m_spring_tiling(false)
+    , m_tile_window_rows(0)
+    , m_sleep(NULL)
+    , m_sleep_threshold(0.0f)
+    , m_long_range(false)
+    , m_self_collision(NULL)
+    , m_edge_kinds(EdgeSprings::STRUCTURAL)
+    , m_edges_dirty(true)
+    , m_multigrid(NULL)
+    , m_projective(NULL)
+    , m_projective_stiffness(1e5f)
+    , m_implicit(NULL)
+    , m_implicit_stiffness(5000.0f)
+    , m_implicit_damping(0.0f)
+    , m_implicit_max_iterations(100)
+    , m_implicit_tolerance(1e-3f)
+    , m_spring_kernels(&spring_kernels_best())
+    , m_pool(new ThreadPool(1))
+    , m_sphere_buffers(1)
     , m_world(world)
-    , m_surface(rows, cols)
+    , m_colliders(world.collider_table())
+    , m_surface(rows, cols, m_arena.allocate(Surface::storage_size(rows, cols)))
     , m_width(width)
     , m_height(height)
     , m_rows(rows)
@@ -68,27 +110,43 @@ Cloth::Cloth(float width, float height, size_t rows, size_t cols, const World &w
     assert(rows >= 2);
     assert(cols >= 2);
     
+    m_edge_stiffness[0] = 0.6f;
+    m_edge_stiffness[1] = 0.3f;
+    m_edge_stiffness[2] = 0.1f;
+    m_edge_compliance[0] = 1e-7f;
+    m_edge_compliance[1] = 1e-6f;
+    m_edge_compliance[2] = 1e-4f;
+    
+    m_spring_stats.iterations = 0;
+    m_spring_stats.max_error = m_spring_stats.rms_error = 0.0f;
+    
     m_dist_to_left = m_width / (m_cols - 1.0f);
     m_dist_to_bottom = m_height / (m_rows - 1.0f);
     
     m_num_points = rows * cols;
-    m_points = new Point[m_num_points];
-    m_prev_points = new Point[m_num_points];
-    m_spring_phase_buf = new Point[m_num_points];
-
-    memset(m_points, m_num_points * sizeof(m_points[0]), 0);
-    memset(m_prev_points, m_num_points * sizeof(m_points[0]), 0);
+    m_points.allocate(m_arena, m_num_points);
+    if (m_prev_storage == PREV_STORAGE_QUANTIZED)
+        m_prev_quantized.allocate(m_arena, m_num_points, cols);
+    else
+        m_prev_points.allocate(m_arena, m_num_points);
     
-    m_invmass = new float[m_num_points];
+    m_invmass = (float*)m_arena.allocate(m_num_points * sizeof(float));
     std::fill(m_invmass, m_invmass + m_num_points, 1.0f);
+    assert(m_arena.used() == m_arena.capacity());
+    update_solver_buffers();
 }
 
 Cloth::~Cloth()
 {
-    delete[] m_points;
-    delete[] m_prev_points;
-    delete[] m_spring_phase_buf;
-    delete[] m_invmass;
+    update_tile_buffers(0);
+    release_solver_buffer(m_spring_phase_buf);
+    release_solver_buffer(m_chebyshev_buf);
+    delete m_multigrid;
+    delete m_projective;
+    delete m_implicit;
+    delete m_sleep;
+    delete m_self_collision;
+    delete m_pool;
 }
 
 void Cloth::lock()
@@ -107,47 +165,957 @@ void Cloth::reset_velocity()
     copy_current_to_prev();
 }
 
+void Cloth::set_pos_at(int i, int j, const glm::vec3 &pos)
+{
+    m_points.set(i * m_cols + j, pos);
+    if (m_sleep != NULL)
+        m_sleep->wake(i / TileSleep::tile_size, j / TileSleep::tile_size);
+}
+
+void Cloth::set_spring_solver(SpringSolver solver)
+{
+    m_spring_solver = solver;
+    update_solver_buffers();
+}
+
+void Cloth::set_integrator(Integrator integrator)
+{
+    m_integrator = integrator;
+    if (m_integrator == INTEGRATOR_IMPLICIT && m_implicit == NULL)
+    {
+        m_implicit = new ImplicitSolver(m_rows, m_cols, m_dist_to_left, m_dist_to_bottom);
+        m_implicit->set_springs(m_implicit_stiffness, m_implicit_damping);
+        m_implicit->set_iterations(m_implicit_max_iterations, m_implicit_tolerance);
+    }
+    else if (m_integrator != INTEGRATOR_IMPLICIT)
+    {
+        delete m_implicit;
+        m_implicit = NULL;
+    }
+    update_solver_buffers();
+}
+
+void Cloth::set_implicit_springs(float stiffness, float damping)
+{
+    m_implicit_stiffness = stiffness;
+    m_implicit_damping = damping;
+    if (m_implicit != NULL)
+        m_implicit->set_springs(stiffness, damping);
+}
+
+void Cloth::set_implicit_solver(int max_iterations, float tolerance)
+{
+    m_implicit_max_iterations = max_iterations;
+    m_implicit_tolerance = tolerance;
+    if (m_implicit != NULL)
+        m_implicit->set_iterations(max_iterations, tolerance);
+}
+
+void Cloth::set_chebyshev(bool enabled, float spectral_radius)
+{
+    assert(spectral_radius > 0.0f && spectral_radius < 1.0f);
+    m_chebyshev_rho = enabled ? spectral_radius : 0.0f;
+    update_solver_buffers();
+}
+
+void Cloth::set_spring_tiling(bool enabled)
+{
+    m_spring_tiling = enabled;
+    if (!enabled)
+        update_tile_buffers(0);
+}
+
+/// (Re)allocate two windows of `window_rows' rows per thread, or free
+/// them all for 0
+void Cloth::update_tile_buffers(size_t window_rows)
+{
+    size_t count = (window_rows > 0) ? 2 * m_pool->size() : 0;
+    if (window_rows == m_tile_window_rows && count == m_tile_buffers.size())
+        return;
+
+    for (size_t k = 0; k < m_tile_buffers.size(); ++k)
+        m_tile_buffers[k].release();
+    m_tile_buffers.assign(count, Vec3Array());
+    for (size_t k = 0; k < count; ++k)
+        m_tile_buffers[k].allocate(window_rows * m_cols);
+    m_tile_window_rows = window_rows;
+}
+
+/// Bytes of the arena: the current and previous positions, the inverse
+/// masses and the surface vertices
+size_t Cloth::arena_size(size_t rows, size_t cols, PrevStorage prev_storage)
+{
+    size_t num_points = rows * cols;
+    size_t prev_size = (prev_storage == PREV_STORAGE_QUANTIZED) ?
+        QuantizedVec3Array::arena_footprint(num_points, cols) :
+        Vec3Array::arena_footprint(num_points);
+    return Vec3Array::arena_footprint(num_points) + prev_size +
+        MemoryArena::footprint(num_points * sizeof(float)) +
+        MemoryArena::footprint(Surface::storage_size(rows, cols));
+}
+
+/// Allocate a scratch buffer of the Jacobi solver, holding the current
+/// positions so that the sleeping tiles, which are not relaxed, keep
+/// theirs when it swaps places with m_points
+void Cloth::allocate_solver_buffer(Vec3Array &buf)
+{
+    if (buf.x != NULL)
+        return;
+    buf.allocate(m_num_points);
+    buf.assign(m_points, m_num_points);
+}
+
+/// Free a scratch buffer of the Jacobi solver. The relaxation swaps the
+/// buffers with m_points, so `buf' may hold the streams of the arena by
+/// now; the positions then move back into them first.
+void Cloth::release_solver_buffer(Vec3Array &buf)
+{
+    if (buf.x == NULL)
+        return;
+    if (m_arena.owns(buf.x))
+    {
+        buf.assign(m_points, m_num_points);
+        std::swap(buf, m_points);
+    }
+    buf.release();
+}
+
+/// Set up the state the current solver needs, free the rest
+void Cloth::update_solver_buffers()
+{
+    // the implicit integrator decodes quantized previous positions
+    // into the scratch buffer
+    bool jacobi = (m_spring_solver == SPRING_SOLVER_JACOBI);
+    bool scratch = jacobi ||
+        (m_integrator == INTEGRATOR_IMPLICIT && m_prev_storage == PREV_STORAGE_QUANTIZED);
+    bool chebyshev = jacobi && m_chebyshev_rho > 0.0f;
+
+    if (scratch)
+        allocate_solver_buffer(m_spring_phase_buf);
+    else
+        release_solver_buffer(m_spring_phase_buf);
+
+    if (chebyshev)
+        allocate_solver_buffer(m_chebyshev_buf);
+    else
+        release_solver_buffer(m_chebyshev_buf);
+
+    if (m_spring_solver == SPRING_SOLVER_MULTIGRID && m_multigrid == NULL)
+    {
+        m_multigrid = new SpringMultigrid;
+        m_multigrid->build(m_rows, m_cols, m_dist_to_left, m_dist_to_bottom);
+    }
+    else if (m_spring_solver != SPRING_SOLVER_MULTIGRID)
+    {
+        delete m_multigrid;
+        m_multigrid = NULL;
+    }
+
+    if (m_spring_solver == SPRING_SOLVER_PROJECTIVE && m_projective == NULL)
+    {
+        m_projective = new ProjectiveSolver(m_rows, m_cols, m_dist_to_left, m_dist_to_bottom);
+        m_projective->set_stiffness(m_projective_stiffness);
+    }
+    else if (m_spring_solver != SPRING_SOLVER_PROJECTIVE)
+    {
+        delete m_projective;
+        m_projective = NULL;
+    }
+}
+
+void Cloth::set_projective_stiffness(float stiffness)
+{
+    m_projective_stiffness = stiffness;
+    if (m_projective != NULL)
+        m_projective->set_stiffness(stiffness);
+}
+
+void Cloth::set_edge_springs(unsigned kinds)
+{
+    m_edge_kinds = kinds;
+    m_edges_dirty = true;
+}
+
+void Cloth::set_edge_stiffness(EdgeSprings::Kind kind, float stiffness)
+{
+    for (int k = 0; k < EdgeSprings::num_kinds; ++k)
+    {
+        if (kind == (1 << k))
+            m_edge_stiffness[k] = stiffness;
+    }
+    m_edges_dirty = true;
+}
+
+void Cloth::set_edge_compliance(EdgeSprings::Kind kind, float compliance)
+{
+    assert(compliance >= 0.0f);
+    for (int k = 0; k < EdgeSprings::num_kinds; ++k)
+    {
+        if (kind == (1 << k))
+            m_edge_compliance[k] = compliance;
+    }
+    m_edges_dirty = true;
+}
+
+void Cloth::set_substeps(int substeps)
+{
+    assert(substeps >= 1);
+    m_substeps = substeps;
+}
+
+void Cloth::set_spring_iterations(int min_iterations, int max_iterations)
+{
+    assert(min_iterations >= 0 && min_iterations <= max_iterations);
+    m_spring_min_iterations = min_iterations;
+    m_spring_max_iterations = max_iterations;
+}
+
+void Cloth::set_spring_tolerance(float tolerance)
+{
+    m_spring_tolerance = tolerance;
+}
+
+bool Cloth::set_spring_kernels(const char *name)
+{
+    const SpringKernels *kernels = spring_kernels_find(name);
+    if (kernels == NULL)
+        return false;
+    m_spring_kernels = kernels;
+    return true;
+}
+
+const char* Cloth::spring_kernels() const
+{
+    return m_spring_kernels->name;
+}
+
+void Cloth::set_long_range_attachments(bool enabled)
+{
+    m_long_range = enabled;
+    if (enabled)
+    {
+        m_pins_dirty = true;
+    }
+    else
+    {
+        m_attach_pin.clear();
+        m_attach_dist.clear();
+    }
+}
+
+void Cloth::set_self_collision(bool enabled, float distance)
+{
+    delete m_self_collision;
+    m_self_collision = NULL;
+    if (!enabled)
+        return;
+    if (distance <= 0.0f)
+        distance = std::min(m_dist_to_left, m_dist_to_bottom);
+    m_self_collision = new SelfCollision(m_rows, m_cols, distance);
+}
+
+void Cloth::set_sleeping(bool enabled, float threshold)
+{
+    m_sleep_threshold = threshold;
+    if (enabled && m_sleep == NULL)
+    {
+        m_sleep = new TileSleep(m_rows, m_cols);
+    }
+    else if (!enabled)
+    {
+        delete m_sleep;
+        m_sleep = NULL;
+    }
+}
+
+size_t Cloth::awake_tiles() const
+{
+    return (m_sleep != NULL) ? m_sleep->num_awake() : num_tiles();
+}
+
+size_t Cloth::num_tiles() const
+{
+    size_t n = TileSleep::tile_size;
+    return ((m_rows + n - 1) / n) * ((m_cols + n - 1) / n);
+}
+
+double Cloth::step_cost() const
+{
+    int iterations = m_spring_stats.iterations;
+    if (m_prev_dt < 0)
+        iterations = m_substeps * m_spring_max_iterations;
+    double awake = (double)m_num_points * awake_tiles() / num_tiles();
+    return awake * (iterations + m_substeps);
+}
+
+void Cloth::set_num_threads(size_t num_threads)
+{
+    assert(num_threads >= 1);
+    if (num_threads == m_pool->size())
+        return;
+    delete m_pool;
+    m_pool = new ThreadPool(num_threads);
+    m_sphere_buffers.resize(num_threads);
+}
+
+size_t Cloth::num_threads() const
+{
+    return m_pool->size();
+}
+
 void Cloth::draw()
 {
     m_surface.draw();
 }
 
+/// View of `v' starting at element `offset'
+static Vec3Array offset_view(const Vec3Array &v, size_t offset)
+{
+    Vec3Array res;
+    res.x = v.x + offset;
+    res.y = v.y + offset;
+    res.z = v.z + offset;
+    return res;
+}
+
+/// Points of a row that share a bounding box for collisions
+static const size_t collide_run_points = 32;
+/// Slack of the box tests against rounding; a collider only counts as
+/// missing a box when it misses it by more
+static const float cull_margin = 1e-4f;
+
+/// Attachment of a point that hangs from no pin
+static const unsigned no_attachment = ~0u;
+
+/// The per-point passes of a substep before and after the spring
+/// relaxation. They work on any range of points, so that a solver can
+/// fuse them into its own sweep over the grid. Both treat every point
+/// alike and then put the pinned points of the range back. Points of
+/// sleeping tiles are left alone.
+struct PointPasses
+{
+    Vec3Array pos, prev;
+    // replaces `prev' with PREV_STORAGE_QUANTIZED, else unallocated
+    QuantizedVec3Array prev_quantized;
+    size_t cols;
+    integrate_stream_fn integrate_stream;
+    float damping, dt_coeff;
+    glm::vec3 accel_dt2;
+    const ColliderTable *colliders;
+    // the spheres of `colliders' binned, or NULL to test all of them
+    const SphereGrid *sphere_grid;
+    // one per thread, for the spheres the grid lists near a run
+    std::vector<unsigned> *sphere_buffers;
+    // pinned indices in ascending order, and their saved positions
+    const std::vector<size_t> *pinned;
+    const std::vector<glm::vec3> *pinned_pos, *pinned_prev;
+    // NULL unless sleeping is on
+    const TileSleep *sleep;
+    // the pin (index into `pinned') each point hangs from and its
+    // distance; NULL unless long-range attachments are on
+    const unsigned *attach_pin;
+    const float *attach_dist;
+
+    /// Verlet integration of points [begin, end)
+    void integrate(size_t begin, size_t end) const
+    {
+        for_awake(&PointPasses::integrate_awake, pos, begin, end, 0);
+    }
+
+    /// Push points [begin, end) of `p' out of the planes, then out of
+    /// the spheres of the collider table, as thread `thread_idx'
+    void collide(const Vec3Array &p, size_t begin, size_t end, size_t thread_idx) const
+    {
+        for_awake(&PointPasses::collide_awake, p, begin, end, thread_idx);
+    }
+
+    /// Pull points [begin, end) of `p' that are further from their pin
+    /// than allowed back towards it
+    void attach(const Vec3Array &p, size_t begin, size_t end) const
+    {
+        for_awake(&PointPasses::attach_awake, p, begin, end, 0);
+    }
+
+private:
+    typedef void (PointPasses::*RangeFn)(const Vec3Array &p, size_t begin, size_t end,
+                                         size_t thread_idx) const;
+
+    /// Run `fn' on the awake parts of points [begin, end), which have
+    /// to cover whole rows. Runs of rows that are all awake go at once.
+    void for_awake(RangeFn fn, const Vec3Array &p, size_t begin, size_t end,
+                   size_t thread_idx) const
+    {
+        if (sleep == NULL)
+        {
+            (this->*fn)(p, begin, end, thread_idx);
+            return;
+        }
+
+        assert(begin % cols == 0 && end % cols == 0);
+        size_t i1 = end / cols;
+        for (size_t i = begin / cols; i < i1; )
+        {
+            size_t next = std::min((i / TileSleep::tile_size + 1) * TileSleep::tile_size, i1);
+            const std::vector<TileSleep::Span> &spans = sleep->awake_spans(i);
+            if (spans.size() == 1 && spans[0].j0 == 0 && spans[0].j1 == cols)
+            {
+                (this->*fn)(p, i * cols, next * cols, thread_idx);
+                i = next;
+                continue;
+            }
+            for (; i < next; ++i)
+            {
+                for (size_t k = 0; k < spans.size(); ++k)
+                    (this->*fn)(p, i * cols + spans[k].j0, i * cols + spans[k].j1, thread_idx);
+            }
+        }
+    }
+
+    /// Verlet integration of points [begin, end) of `p'. Quantized
+    /// previous positions are decoded and encoded again a block at a
+    /// time, so the range has to start and end on block boundaries.
+    void integrate_awake(const Vec3Array &p, size_t begin, size_t end, size_t) const
+    {
+        if (prev_quantized.x == NULL)
+        {
+            integrate_streams(p, begin, end, prev.x + begin, prev.y + begin, prev.z + begin);
+            return;
+        }
+
+        assert((begin % cols) % QuantizedVec3Array::block_size == 0);
+        float ox[QuantizedVec3Array::block_size];
+        float oy[QuantizedVec3Array::block_size];
+        float oz[QuantizedVec3Array::block_size];
+        for (size_t idx = begin; idx < end; )
+        {
+            size_t next = prev_quantized.block_end(idx);
+            prev_quantized.decode_block(idx, next - idx, ox, oy, oz);
+            integrate_streams(p, idx, next, ox, oy, oz);
+            prev_quantized.encode_block(idx, next - idx, ox, oy, oz);
+            idx = next;
+        }
+    }
+
+    /// Verlet integration of points [begin, end) of `p' whose previous
+    /// positions are in the streams from `ox', `oy', `oz'
+    void integrate_streams(const Vec3Array &p, size_t begin, size_t end,
+                           float *ox, float *oy, float *oz) const
+    {
+        size_t n = end - begin;
+        integrate_stream(p.x + begin, ox, n, damping, dt_coeff, accel_dt2.x);
+        integrate_stream(p.y + begin, oy, n, damping, dt_coeff, accel_dt2.y);
+        integrate_stream(p.z + begin, oz, n, damping, dt_coeff, accel_dt2.z);
+
+        for (size_t k = first_pinned(begin); k < pinned->size() && (*pinned)[k] < end; ++k)
+        {
+            size_t idx = (*pinned)[k];
+            const glm::vec3 &pp = (*pinned_prev)[k];
+            p.set(idx, (*pinned_pos)[k]);
+            ox[idx - begin] = pp.x;
+            oy[idx - begin] = pp.y;
+            oz[idx - begin] = pp.z;
+        }
+    }
+
+    /// Short runs of a row stay close together, so each collider is
+    /// tested against the run's bounding box first and only pushes its
+    /// points if it reaches into it. The colliders go in the order of
+    /// the table, and the box is measured again whenever one moved a
+    /// point, which may have carried it into later ones.
+    void collide_awake(const Vec3Array &p, size_t begin, size_t end, size_t thread_idx) const
+    {
+        const ColliderTable &c = *colliders;
+        std::vector<unsigned> &candidates = sphere_buffers[thread_idx];
+        for (size_t b = begin; b < end; b += collide_run_points)
+        {
+            size_t e = std::min(b + collide_run_points, end);
+            glm::vec3 lo, hi;
+            run_bounds(p, b, e, lo, hi);
+
+            for (size_t k = 0; k < c.num_planes(); ++k)
+            {
+                if (c.plane_min_equ(k, lo, hi) < cull_margin && push_out_of_plane(p, b, e, k))
+                    run_bounds(p, b, e, lo, hi);
+            }
+
+            if (sphere_grid == NULL)
+            {
+                for (size_t k = 0; k < c.num_spheres(); ++k)
+                {
+                    if (sphere_reaches(k, lo, hi) && push_out_of_sphere(p, b, e, k))
+                        run_bounds(p, b, e, lo, hi);
+                }
+                continue;
+            }
+
+            // ask the grid again for the spheres after the last one
+            // once the box has grown out of what it was asked for
+            glm::vec3 query_lo = lo, query_hi = hi;
+            sphere_grid->query(query_lo, query_hi, candidates);
+            for (size_t m = 0; m < candidates.size(); ++m)
+            {
+                unsigned k = candidates[m];
+                if (!sphere_reaches(k, lo, hi) || !push_out_of_sphere(p, b, e, k))
+                    continue;
+                run_bounds(p, b, e, lo, hi);
+                if (glm::any(glm::lessThan(lo, query_lo)) || glm::any(glm::greaterThan(hi, query_hi)))
+                {
+                    query_lo = glm::min(query_lo, lo);
+                    query_hi = glm::max(query_hi, hi);
+                    sphere_grid->query(query_lo, query_hi, candidates);
+                    m = std::upper_bound(candidates.begin(), candidates.end(), k) - candidates.begin() - 1;
+                }
+            }
+        }
+
+        for (size_t k = first_pinned(begin); k < pinned->size() && (*pinned)[k] < end; ++k)
+            p.set((*pinned)[k], (*pinned_pos)[k]);
+    }
+
+    static void run_bounds(const Vec3Array &p, size_t begin, size_t end,
+                           glm::vec3 &lo, glm::vec3 &hi)
+    {
+        lo = hi = p.get(begin);
+        for (size_t idx = begin + 1; idx < end; ++idx)
+        {
+            glm::vec3 v = p.get(idx);
+            lo = glm::min(lo, v);
+            hi = glm::max(hi, v);
+        }
+    }
+
+    bool sphere_reaches(size_t k, const glm::vec3 &lo, const glm::vec3 &hi) const
+    {
+        float r = colliders->sphere_r[k] + cull_margin;
+        return colliders->sphere_box_dist2(k, lo, hi) < r * r;
+    }
+
+    /// Push the points of [begin, end) out of plane `k' of the table;
+    /// returns whether any moved. The run is short enough to stay in
+    /// the L1 cache, and going over it once per collider keeps the
+    /// loops over the points vectorizable.
+    bool push_out_of_plane(const Vec3Array &p, size_t begin, size_t end, size_t k) const
+    {
+        const ColliderTable &c = *colliders;
+        float *px = p.x, *py = p.y, *pz = p.z;
+        const float nx = c.plane_nx[k], ny = c.plane_ny[k], nz = c.plane_nz[k];
+        const float pd = c.plane_d[k];
+        bool moved = false;
+        
+        for (size_t idx = begin; idx < end; ++idx)
+        {
+            float d = (nx * px[idx] + ny * py[idx] + nz * pz[idx]) + pd;
+            if (d < 0)
+            {
+                px[idx] -= nx * d;
+                py[idx] -= ny * d;
+                pz[idx] -= nz * d;
+                moved = true;
+            }
+        }
+        return moved;
+    }
+
+    /// Push the points of [begin, end) out of sphere `k' of the table;
+    /// returns whether any moved
+    bool push_out_of_sphere(const Vec3Array &p, size_t begin, size_t end, size_t k) const
+    {
+        const ColliderTable &c = *colliders;
+        float *px = p.x, *py = p.y, *pz = p.z;
+        const float ox = c.sphere_x[k], oy = c.sphere_y[k], oz = c.sphere_z[k];
+        float r = c.sphere_r[k];
+        float r2 = r * r;
+        bool moved = false;
+        
+        for (size_t idx = begin; idx < end; ++idx)
+        {
+            float vx = px[idx] - ox;
+            float vy = py[idx] - oy;
+            float vz = pz[idx] - oz;
+            float d = (vx * vx + vy * vy + vz * vz) - r2;
+            if (d < 0)
+            {
+                float s = r / sqrtf(r2 + d);
+                px[idx] = s * vx + ox;
+                py[idx] = s * vy + oy;
+                pz[idx] = s * vz + oz;
+                moved = true;
+            }
+        }
+        return moved;
+    }
+
+    void attach_awake(const Vec3Array &p, size_t begin, size_t end, size_t) const
+    {
+        float *px = p.x, *py = p.y, *pz = p.z;
+        for (size_t idx = begin; idx < end; ++idx)
+        {
+            unsigned k = attach_pin[idx];
+            if (k == no_attachment)
+                continue;
+            const glm::vec3 &a = (*pinned_pos)[k];
+            float vx = px[idx] - a.x;
+            float vy = py[idx] - a.y;
+            float vz = pz[idx] - a.z;
+            float d2 = vx * vx + vy * vy + vz * vz;
+            float l = attach_dist[idx];
+            if (d2 > l * l)
+            {
+                float s = l / sqrtf(d2);
+                px[idx] = a.x + vx * s;
+                py[idx] = a.y + vy * s;
+                pz[idx] = a.z + vz * s;
+            }
+        }
+    }
+
+    size_t first_pinned(size_t begin) const
+    {
+        return std::lower_bound(pinned->begin(), pinned->end(), begin) - pinned->begin();
+    }
+};
+
+/// Long-range attachments over the awake points, each thread taking a
+/// band of rows, optionally followed by the collisions
+class AttachTask : public ParallelTask
+{
+    const PointPasses &m_passes;
+    const Vec3Array &m_pos;
+    size_t m_rows;
+    bool m_collide;
+
+public:
+    AttachTask(const PointPasses &passes, const Vec3Array &pos, size_t rows, bool collide)
+        : m_passes(passes)
+        , m_pos(pos)
+        , m_rows(rows)
+        , m_collide(collide)
+    {
+    }
+
+    virtual void run(size_t thread_idx, size_t num_threads, Barrier &)
+    {
+        size_t i0, i1;
+        partition_range(m_rows, num_threads, thread_idx, &i0, &i1);
+        size_t begin = i0 * m_passes.cols, end = i1 * m_passes.cols;
+        m_passes.attach(m_pos, begin, end);
+        if (m_collide)
+            m_passes.collide(m_pos, begin, end, thread_idx);
+    }
+};
+
+/// Self-collision, followed by the collisions with the world over the
+/// band of rows each thread moved
+class SelfCollisionTask : public ParallelTask
+{
+    const PointPasses &m_passes;
+    SelfCollision &m_self_collision;
+    const Vec3Array &m_pos;
+    size_t m_rows;
+
+public:
+    SelfCollisionTask(const PointPasses &passes, SelfCollision &self_collision,
+                      const Vec3Array &pos, size_t rows)
+        : m_passes(passes)
+        , m_self_collision(self_collision)
+        , m_pos(pos)
+        , m_rows(rows)
+    {
+    }
+
+    virtual void run(size_t thread_idx, size_t num_threads, Barrier &barrier)
+    {
+        m_self_collision.run(thread_idx, num_threads, barrier);
+        size_t i0, i1;
+        partition_range(m_rows, num_threads, thread_idx, &i0, &i1);
+        m_passes.collide(m_pos, i0 * m_passes.cols, i1 * m_passes.cols, thread_idx);
+    }
+};
+
+void Cloth::update_pins()
+{
+    m_pinned.clear();
+    for (size_t idx = 0; idx < m_num_points; ++idx)
+    {
+        if (m_invmass[idx] == 0.0f)
+            m_pinned.push_back(idx);
+    }
+    m_pinned_pos.resize(m_pinned.size());
+    m_pinned_prev.resize(m_pinned.size());
+
+    if (m_projective != NULL)
+        m_projective->invalidate();
+    if (m_sleep != NULL)
+        m_sleep->wake_all();
+    if (m_long_range)
+        update_attachments();
+    m_pins_dirty = false;
+}
+
+/// Find the nearest pin of every point and its distance along the rest
+/// shape of the grid, by Dijkstra's algorithm over the horizontal,
+/// vertical and diagonal neighbours. That distance is never shorter
+/// than the straight one, so the attachments don't fight the springs.
+void Cloth::update_attachments()
+{
+    m_attach_pin.assign(m_num_points, no_attachment);
+    m_attach_dist.assign(m_num_points, FLT_MAX);
+    
+    typedef std::pair<float, size_t> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+    for (size_t k = 0; k < m_pinned.size(); ++k)
+    {
+        m_attach_pin[m_pinned[k]] = (unsigned)k;
+        m_attach_dist[m_pinned[k]] = 0.0f;
+        queue.push(Entry(0.0f, m_pinned[k]));
+    }
+
+    float diagonal = sqrtf(m_dist_to_left * m_dist_to_left +
+                           m_dist_to_bottom * m_dist_to_bottom);
+    while (!queue.empty())
+    {
+        Entry e = queue.top();
+        queue.pop();
+        size_t idx = e.second;
+        if (e.first > m_attach_dist[idx])
+            continue;
+        
+        size_t i = idx / m_cols, j = idx % m_cols;
+        for (int di = -1; di <= 1; ++di)
+        {
+            for (int dj = -1; dj <= 1; ++dj)
+            {
+                size_t ni = i + di, nj = j + dj;
+                if ((di == 0 && dj == 0) || ni >= m_rows || nj >= m_cols)
+                    continue;
+                float w = (di == 0) ? m_dist_to_left : (dj == 0) ? m_dist_to_bottom : diagonal;
+                size_t n = ni * m_cols + nj;
+                if (e.first + w < m_attach_dist[n])
+                {
+                    m_attach_dist[n] = e.first + w;
+                    m_attach_pin[n] = m_attach_pin[idx];
+                    queue.push(Entry(m_attach_dist[n], n));
+                }
+            }
+        }
+    }
+
+    // the pins stay in place anyway
+    for (size_t k = 0; k < m_pinned.size(); ++k)
+        m_attach_pin[m_pinned[k]] = no_attachment;
+}
+
+void Cloth::save_pinned()
+{
+    for (size_t k = 0; k < m_pinned.size(); ++k)
+    {
+        m_pinned_pos[k] = m_points.get(m_pinned[k]);
+        m_pinned_prev[k] = prev_at(m_pinned[k]);
+    }
+}
+
+glm::vec3 Cloth::prev_at(size_t idx) const
+{
+    if (m_prev_storage == PREV_STORAGE_QUANTIZED)
+        return m_prev_quantized.get(idx);
+    return m_prev_points.get(idx);
+}
+
 void Cloth::step(float dt)
+{
+    float h = dt / m_substeps;
+    int iterations = 0;
+    for (int s = 0; s < m_substeps; ++s)
+    {
+        substep(h);
+        iterations += m_spring_stats.iterations;
+    }
+    m_spring_stats.iterations = iterations;
+}
+
+void Cloth::substep(float dt)
 {
     // Time-corrected Verlet integration as described in:
     // http://lonesock.net/article/verlet.html
     
     if (m_prev_dt < 0)
         m_prev_dt = dt;
-    
-    float dt2 = dt * dt;
-    float dt_coeff = dt / m_prev_dt;
 
-    // apply force
-    for (size_t i = 0; i < m_rows; ++i)
+    if (m_pins_dirty)
+        update_pins();
+
+    TileSleep *sleep = active_sleep();
+    if (sleep != NULL)
     {
-        for (size_t j = 0; j < m_cols; ++j)
+        sleep->wake_touched(m_world, m_sleep_threshold);
+        if (sleep->num_awake() == 0)
         {
-            size_t idx = i * m_cols + j;
-            if (m_invmass[idx] == 0.0f) continue;
-            Point tmp = m_points[idx];
-            Point &x = m_points[idx];
-            Point &x_prev = m_prev_points[idx];
-            m_points[idx].pos = x.pos +
-                ((x.pos - x_prev.pos) * 0.99f * dt_coeff) +
-                m_gravity * dt2;
-            m_prev_points[idx] = tmp;
+            m_spring_stats.iterations = 0;
+            m_spring_stats.max_error = m_spring_stats.rms_error = 0.0f;
+            m_prev_dt = dt;
+            return;
         }
     }
+    
+    save_pinned();
+    PointPasses passes = point_passes(dt, sleep);
 
-    apply_spring_constraints();
+    if (m_integrator == INTEGRATOR_IMPLICIT)
+    {
+        step_implicit(dt);
+        passes.collide(m_points, 0, m_num_points, 0);
+        m_prev_dt = dt;
+        return;
+    }
 
-    apply_plane_constraints();
-    apply_sphere_constraints();
+    // The Jacobi solver integrates in its first sweep over the grid
+    bool fused = (m_spring_solver == SPRING_SOLVER_JACOBI && m_spring_max_iterations > 0);
+    if (!fused)
+        passes.integrate(0, m_num_points);
+
+    // the collisions with the world come last, along with the last of
+    // these passes that runs
+    bool collided = apply_spring_constraints(dt, fused ? &passes : NULL, sleep);
+    if (m_long_range && !m_pinned.empty())
+    {
+        AttachTask task(passes, m_points, m_rows, m_self_collision == NULL);
+        m_pool->run(task);
+        collided = (m_self_collision == NULL);
+    }
+    if (m_self_collision != NULL)
+    {
+        m_self_collision->prepare(m_points, m_invmass, sleep, m_pool->size());
+        SelfCollisionTask task(passes, *m_self_collision, m_points, m_rows);
+        m_pool->run(task);
+        collided = true;
+    }
+    if (!collided)
+        passes.collide(m_points, 0, m_num_points, 0);
 
+    if (sleep != NULL)
+        update_sleep();
     m_prev_dt = dt;
 }
 
+/// The tile sleep state if sleeping is on and the current setup
+/// supports it. Otherwise all tiles are woken, so that the cloth is
+/// awake when the setup changes back.
+TileSleep* Cloth::active_sleep()
+{
+    if (m_sleep == NULL)
+        return NULL;
+    if (m_integrator == INTEGRATOR_VERLET && !m_spring_tiling &&
+        (m_spring_solver == SPRING_SOLVER_JACOBI || m_spring_solver == SPRING_SOLVER_RED_BLACK))
+        return m_sleep;
+    m_sleep->wake_all();
+    return NULL;
+}
+
+/// Measure how far the points of each awake tile moved during the
+/// substep and let the tiles settle. The tiles that fell asleep get
+/// their previous positions set to the current ones, and a copy of
+/// them goes to the Jacobi buffers, as nothing writes them any more.
+void Cloth::update_sleep()
+{
+    const size_t n = TileSleep::tile_size;
+    // sleeping tiles are encoded as whole blocks
+    assert(n % QuantizedVec3Array::block_size == 0);
+    
+    for (size_t ti = 0; ti < m_sleep->tile_rows(); ++ti)
+    {
+        for (size_t tj = 0; tj < m_sleep->tile_cols(); ++tj)
+        {
+            if (m_sleep->asleep(ti, tj))
+                continue;
+            size_t i1 = std::min((ti + 1) * n, m_rows);
+            size_t j1 = std::min((tj + 1) * n, m_cols);
+            glm::vec3 lo = m_points.get(ti * n * m_cols + tj * n), hi = lo;
+            float motion2 = 0.0f;
+            for (size_t i = ti * n; i < i1; ++i)
+            {
+                for (size_t idx = i * m_cols + tj * n; idx < i * m_cols + j1; ++idx)
+                {
+                    glm::vec3 p = m_points.get(idx);
+                    glm::vec3 d = p - prev_at(idx);
+                    motion2 = std::max(motion2, glm::dot(d, d));
+                    lo = glm::min(lo, p);
+                    hi = glm::max(hi, p);
+                }
+            }
+            m_sleep->set_motion(ti, tj, sqrtf(motion2), lo, hi);
+        }
+    }
+
+    m_fell_asleep.clear();
+    m_sleep->settle(m_world, m_sleep_threshold, m_fell_asleep);
+    
+    for (size_t k = 0; k < m_fell_asleep.size(); ++k)
+    {
+        size_t ti = m_fell_asleep[k] / m_sleep->tile_cols();
+        size_t tj = m_fell_asleep[k] % m_sleep->tile_cols();
+        size_t i1 = std::min((ti + 1) * n, m_rows);
+        size_t j1 = std::min((tj + 1) * n, m_cols);
+        for (size_t i = ti * n; i < i1; ++i)
+        {
+            size_t begin = i * m_cols + tj * n, end = i * m_cols + j1;
+            Vec3Array row = offset_view(m_points, begin);
+            if (m_spring_phase_buf.x != NULL)
+                offset_view(m_spring_phase_buf, begin).assign(row, end - begin);
+            if (m_chebyshev_buf.x != NULL)
+                offset_view(m_chebyshev_buf, begin).assign(row, end - begin);
+            if (m_prev_storage == PREV_STORAGE_QUANTIZED)
+                m_prev_quantized.encode(m_points, begin, end);
+            else
+                offset_view(m_prev_points, begin).assign(row, end - begin);
+        }
+    }
+}
+
+PointPasses Cloth::point_passes(float dt, const TileSleep *sleep) const
+{
+    PointPasses passes;
+    passes.pos = m_points;
+    passes.prev = m_prev_points;
+    passes.prev_quantized = m_prev_quantized;
+    passes.cols = m_cols;
+    passes.integrate_stream = m_spring_kernels->integrate_stream;
+    passes.sleep = sleep;
+    passes.attach_pin = m_long_range ? &m_attach_pin[0] : NULL;
+    passes.attach_dist = m_long_range ? &m_attach_dist[0] : NULL;
+    // the velocity loses 1% per step, however many substeps it takes
+    passes.damping = (m_substeps == 1) ? 0.99f : powf(0.99f, 1.0f / m_substeps);
+    passes.dt_coeff = dt / m_prev_dt;
+    passes.accel_dt2 = m_gravity * (dt * dt);
+    passes.colliders = &m_colliders;
+    passes.sphere_grid = m_world.sphere_grid();
+    passes.sphere_buffers = &m_sphere_buffers[0];
+    passes.pinned = &m_pinned;
+    passes.pinned_pos = &m_pinned_pos;
+    passes.pinned_prev = &m_pinned_prev;
+    return passes;
+}
+
+void Cloth::step_implicit(float dt)
+{
+    // the implicit solver works on float previous positions; decode
+    // them into the Jacobi scratch buffer, which it leaves alone
+    Vec3Array prev = m_prev_points;
+    if (m_prev_storage == PREV_STORAGE_QUANTIZED)
+    {
+        prev = m_spring_phase_buf;
+        m_prev_quantized.decode(prev, 0, m_num_points);
+    }
+    m_implicit->step(*m_pool, m_points, prev, m_invmass, m_gravity, dt, m_prev_dt);
+    if (m_prev_storage == PREV_STORAGE_QUANTIZED)
+        m_prev_quantized.encode(prev, 0, m_num_points);
+
+    const SpringError &stretch = m_implicit->stretch();
+    size_t num_springs = m_rows * (m_cols - 1) + m_cols * (m_rows - 1);
+    m_spring_stats.iterations = m_implicit->iterations();
+    m_spring_stats.max_error = stretch.max;
+    m_spring_stats.rms_error = (float)sqrt(stretch.sum_sq / num_springs);
+}
+
 void Cloth::upload()
 {
     for (size_t i = 0; i < m_rows; ++i)
@@ -155,115 +1123,679 @@ void Cloth::upload()
         for (size_t j = 0; j < m_cols; ++j)
         {
             size_t idx = i * m_cols + j;
-            m_surface.pos_at(i, j) = m_points[idx].pos;
+            m_surface.pos_at(i, j) = m_points.get(idx);
         }
     }
 }
 
 void Cloth::copy_current_to_prev()
 {
-    std::copy(m_points, m_points + m_num_points, m_prev_points);
+    if (m_prev_storage == PREV_STORAGE_QUANTIZED)
+        m_prev_quantized.encode(m_points, 0, m_num_points);
+    else
+        m_prev_points.assign(m_points, m_num_points);
 }
 
-void Cloth::apply_plane_constraints()
+namespace {
+
+/// Decides when the spring relaxation stops. After each iteration
+/// every thread posts the error measured in its band; once all are in,
+/// each thread merges them and takes the same decision.
+class IterationControl
 {
-    for (World::plane_array_t::const_iterator it = m_world.planes.begin();
-         it != m_world.planes.end(); ++it)
+    int m_min_iterations, m_max_iterations;
+    float m_tolerance;
+    // indexed by iteration parity, so that a thread may post the next
+    // iteration's error while others still read the current one
+    std::vector<SpringError> m_errors[2];
+    
+public:
+    int iterations_done;
+    SpringError error;
+    
+    IterationControl(size_t num_threads, int min_iterations, int max_iterations,
+                     float tolerance)
+        : m_min_iterations(min_iterations)
+        , m_max_iterations(max_iterations)
+        , m_tolerance(tolerance)
+        , iterations_done(0)
+    {
+        m_errors[0].resize(num_threads);
+        m_errors[1].resize(num_threads);
+    }
+
+    int max_iterations() const { return m_max_iterations; }
+    /// Whether every relaxation runs exactly max_iterations()
+    bool fixed() const { return m_min_iterations >= m_max_iterations; }
+
+    /// Post this thread's error of iteration `iter' and wait for the
+    /// others; returns whether to run another iteration
+    bool next(size_t thread_idx, int iter, const SpringError &thread_error,
+              Barrier &barrier)
     {
-        for (size_t idx = 0; idx < m_num_points; ++idx)
+        std::vector<SpringError> &errors = m_errors[iter % 2];
+        errors[thread_idx] = thread_error;
+        barrier.wait();
+
+        SpringError total;
+        for (size_t i = 0; i < errors.size(); ++i)
+            total.merge(errors[i]);
+
+        bool done = (iter + 1 >= m_max_iterations) ||
+            (iter + 1 >= m_min_iterations && total.max < m_tolerance);
+        if (done && thread_idx == 0)
         {
-            if (m_invmass[idx] == 0.0f) continue;
-            Point &p = m_points[idx];
-            Plane *pl = *it;
-            float d = pl->equ(p.pos);
-            if (d < 0)
+            iterations_done = iter + 1;
+            error = total;
+        }
+        return !done;
+    }
+};
+
+/// Chebyshev semi-iterative weight of iteration `iter' (0-based), see
+/// Wang, "A Chebyshev Semi-Iterative Approach for Accelerating
+/// Projective and Position-based Dynamics", 2015
+static float chebyshev_omega(int iter, float rho, float prev_omega)
+{
+    float rho2 = rho * rho;
+    if (iter == 0)
+        return 1.0f;
+    else if (iter == 1)
+        return 2.0f / (2.0f - rho2);
+    else
+        return 4.0f / (4.0f - rho2 * prev_omega);
+}
+
+/// x = omega * (x - prev) + prev over elements [begin, end)
+static void extrapolate_stream(float *x, const float *prev, float omega,
+                               size_t begin, size_t end)
+{
+    for (size_t idx = begin; idx < end; ++idx)
+        x[idx] = omega * (x[idx] - prev[idx]) + prev[idx];
+}
+
+/// Relax block [i0, i1) x [j0, j1) of `grid', only the points of
+/// `colour' unless it is NULL
+static void relax_block(const SpringKernels &kernels, const SpringGrid &grid,
+                        size_t i0, size_t i1, size_t j0, size_t j1,
+                        const unsigned *colour, SpringError &error)
+{
+    if (colour != NULL)
+        kernels.relax_block_colour(grid, i0, i1, j0, j1, *colour, error);
+    else
+        kernels.relax_block(grid, i0, i1, j0, j1, error);
+}
+
+/// Relax rows [i0, i1) of `grid' like relax_block(), leaving out the
+/// sleeping tiles of `sleep' unless it is NULL
+static void relax_rows(const SpringKernels &kernels, const SpringGrid &grid,
+                       const TileSleep *sleep, size_t i0, size_t i1,
+                       const unsigned *colour, SpringError &error)
+{
+    if (sleep == NULL)
+    {
+        if (i0 < i1)
+            relax_block(kernels, grid, i0, i1, 0, grid.cols, colour, error);
+        return;
+    }
+    
+    for (size_t i = i0; i < i1; )
+    {
+        size_t next = std::min((i / TileSleep::tile_size + 1) * TileSleep::tile_size, i1);
+        const std::vector<TileSleep::Span> &spans = sleep->awake_spans(i);
+        for (size_t k = 0; k < spans.size(); ++k)
+            relax_block(kernels, grid, i, next, spans[k].j0, spans[k].j1, colour, error);
+        i = next;
+    }
+}
+
+/// Jacobi spring relaxation, each thread relaxing a band of rows.
+/// Every iteration reads the positions written by the previous one,
+/// hence the barrier between them.
+///
+/// With Chebyshev acceleration every iteration's result is extrapolated
+/// from the one two iterations back, which needs a third buffer. The
+/// extrapolation only touches the thread's own band. It is skipped on
+/// the last iteration: Verlet would turn its overshoot into velocity,
+/// and that feedback blows the cloth up at low iteration counts.
+///
+/// The task can also run the substep's integration and collisions, see
+/// set_fused(). The first iteration then integrates each row just
+/// before relaxing the row above it. The last iteration collides every
+/// row as soon as it is written. This saves two trips through memory
+/// over the whole grid.
+class SpringRelaxTask : public ParallelTask
+{
+    const SpringKernels &m_kernels;
+    const SpringGrid &m_grid;
+    IterationControl &m_control;
+    Vec3Array m_extra;
+    float m_rho;
+    const PointPasses *m_passes;
+    bool m_collide;
+    const TileSleep *m_sleep;
+    
+public:
+    /// The buffer holding the final positions
+    Vec3Array result;
+    
+    SpringRelaxTask(const SpringKernels &kernels, const SpringGrid &grid,
+                    IterationControl &control)
+        : m_kernels(kernels)
+        , m_grid(grid)
+        , m_control(control)
+        , m_rho(0.0f)
+        , m_passes(NULL)
+        , m_collide(false)
+        , m_sleep(NULL)
+        , result(grid.src)
+    {
+    }
+
+    /// Leave out the sleeping tiles
+    void set_sleep(const TileSleep *sleep)
+    {
+        m_sleep = sleep;
+    }
+
+    /// Integrate grid.src with `passes' during the first iteration, and
+    /// if `collide', collide the result during the last one
+    void set_fused(const PointPasses *passes, bool collide)
+    {
+        m_passes = passes;
+        m_collide = collide;
+    }
+
+    void set_chebyshev(const Vec3Array &extra, float rho)
+    {
+        m_extra = extra;
+        m_rho = rho;
+    }
+
+    virtual void run(size_t thread_idx, size_t num_threads, Barrier &barrier)
+    {
+        size_t i0, i1;
+        partition_range(m_grid.rows, num_threads, thread_idx, &i0, &i1);
+        size_t begin = i0 * m_grid.cols, end = i1 * m_grid.cols;
+
+        SpringGrid grid = m_grid;
+        // positions two iterations back, unused in the first iteration
+        Vec3Array prev = m_extra;
+        float omega = 1.0f;
+        
+        for (int iter = 0; iter < m_control.max_iterations(); ++iter)
+        {
+            SpringError error;
+            bool integrate = (m_passes != NULL && iter == 0);
+            bool collide = (m_collide && iter + 1 == m_control.max_iterations());
+            if (integrate || collide)
+                relax_fused(grid, thread_idx, i0, i1, integrate, collide, barrier, error);
+            else
+                relax_rows(m_kernels, grid, m_sleep, i0, i1, NULL, error);
+
+            bool more;
+            if (m_rho > 0.0f)
             {
-                p.pos -= pl->n * d;
+                // the iterate the relaxation stops at is not extrapolated;
+                // with a tolerance that is only known after the errors of
+                // all threads are in, so the extrapolation waits for them
+                // and takes a barrier of its own
+                omega = chebyshev_omega(iter, m_rho, omega);
+                if (omega != 1.0f && !m_control.fixed())
+                {
+                    more = m_control.next(thread_idx, iter, error, barrier);
+                    if (more)
+                    {
+                        extrapolate_stream(grid.dst.x, prev.x, omega, begin, end);
+                        extrapolate_stream(grid.dst.y, prev.y, omega, begin, end);
+                        extrapolate_stream(grid.dst.z, prev.z, omega, begin, end);
+                        barrier.wait();
+                    }
+                }
+                else
+                {
+                    if (omega != 1.0f && iter + 1 < m_control.max_iterations())
+                    {
+                        extrapolate_stream(grid.dst.x, prev.x, omega, begin, end);
+                        extrapolate_stream(grid.dst.y, prev.y, omega, begin, end);
+                        extrapolate_stream(grid.dst.z, prev.z, omega, begin, end);
+                    }
+                    more = m_control.next(thread_idx, iter, error, barrier);
+                }
+                Vec3Array oldest = prev;
+                prev = grid.src;
+                grid.src = grid.dst;
+                grid.dst = oldest;
             }
+            else
+            {
+                more = m_control.next(thread_idx, iter, error, barrier);
+                std::swap(grid.src, grid.dst);
+            }
+
+            if (thread_idx == 0)
+                result = grid.src;
+            if (!more)
+                break;
         }
     }
-}
 
-void Cloth::apply_sphere_constraints()
+private:
+    /// Relax rows [i0, i1) one at a time, integrating them first or
+    /// colliding them afterwards
+    void relax_fused(const SpringGrid &grid, size_t thread_idx, size_t i0, size_t i1,
+                     bool integrate, bool collide, Barrier &barrier, SpringError &error)
+    {
+        size_t cols = grid.cols;
+        size_t next = i0;
+        if (integrate)
+        {
+            // the neighbouring bands read our first and last rows
+            if (i0 < i1)
+                m_passes->integrate(i0 * cols, (i0 + 1) * cols);
+            if (i0 + 1 < i1)
+                m_passes->integrate((i1 - 1) * cols, i1 * cols);
+            barrier.wait();
+            next = i0 + 1;
+        }
+
+        for (size_t i = i0; i < i1; ++i)
+        {
+            if (integrate)
+            {
+                // row i + 1, unless it is the last one done above
+                size_t need = (i + 2 < i1 - 1) ? i + 2 : i1 - 1;
+                for (; next < need; ++next)
+                    m_passes->integrate(next * cols, (next + 1) * cols);
+            }
+            relax_rows(m_kernels, grid, m_sleep, i, i + 1, NULL, error);
+            if (collide)
+                m_passes->collide(grid.dst, i * cols, (i + 1) * cols, thread_idx);
+        }
+    }
+};
+
+/// Jacobi spring relaxation tiled in time. Each thread takes its band
+/// of rows a tile at a time and runs all iterations on it before going
+/// on to the next tile.
+///
+/// Iteration k of a tile relaxes the tile plus a halo of K - k rows on
+/// either side, K being the iteration count. The last iteration is left
+/// with just the tile. The intermediate rows go to two per-thread
+/// window buffers, and only the last iteration writes grid.dst. Every
+/// point is relaxed from the same inputs as in the plain sweep, so the
+/// result is the same, while the halo rows are computed twice.
+///
+/// The window is a SpringGrid of its own rows, with its first and last
+/// rows standing in for the grid boundary. That is harmless, since the
+/// halo never reaches them except where they are the real boundary.
+class TiledRelaxTask : public ParallelTask
 {
-    for (World::sphere_array_t::const_iterator it = m_world.spheres.begin();
-         it != m_world.spheres.end(); ++it)
+    const SpringKernels &m_kernels;
+    const SpringGrid &m_grid;
+    IterationControl &m_control;
+    const std::vector<Vec3Array> &m_windows;
+    size_t m_tile_rows;
+    const PointPasses *m_passes;
+    bool m_collide;
+    
+public:
+    TiledRelaxTask(const SpringKernels &kernels, const SpringGrid &grid,
+                   IterationControl &control, const std::vector<Vec3Array> &windows,
+                   size_t tile_rows)
+        : m_kernels(kernels)
+        , m_grid(grid)
+        , m_control(control)
+        , m_windows(windows)
+        , m_tile_rows(tile_rows)
+        , m_passes(NULL)
+        , m_collide(false)
     {
-        Sphere *sp = *it;
-        float r = sp->r;
-        float r2 = r * r;
+    }
+
+    /// Integrate grid.src with `passes' before relaxing it, and if
+    /// `collide', collide the result; see SpringRelaxTask::set_fused()
+    void set_fused(const PointPasses *passes, bool collide)
+    {
+        m_passes = passes;
+        m_collide = collide;
+    }
+
+    virtual void run(size_t thread_idx, size_t num_threads, Barrier &barrier)
+    {
+        const SpringGrid &g = m_grid;
+        size_t num_iterations = m_control.max_iterations();
+        size_t rows = g.rows, cols = g.cols;
+        size_t i0, i1;
+        partition_range(rows, num_threads, thread_idx, &i0, &i1);
+
+        // Integrate the rows the neighbouring bands' halos read first,
+        // the rest just before the first window that reaches them
+        size_t next = i0, last = i1;
+        if (m_passes != NULL)
+        {
+            next = std::min(i0 + num_iterations, i1);
+            last = std::max(next, (i1 > num_iterations) ? i1 - num_iterations : 0);
+            m_passes->integrate(i0 * cols, next * cols);
+            m_passes->integrate(last * cols, i1 * cols);
+            barrier.wait();
+        }
+
+        SpringError error;
+        Vec3Array window[2] = { m_windows[2 * thread_idx], m_windows[2 * thread_idx + 1] };
         
-        for (size_t idx = 0; idx < m_num_points; ++idx)
+        for (size_t t0 = i0; t0 < i1; t0 += m_tile_rows)
         {
-            if (m_invmass[idx] == 0.0f) continue;
-            Point &p = m_points[idx];
-            float d = sp->equ(p.pos);
-            if (d < 0)
+            size_t t1 = std::min(t0 + m_tile_rows, i1);
+            size_t lo = (t0 > num_iterations) ? t0 - num_iterations : 0;
+            size_t hi = std::min(t1 + num_iterations, rows);
+
+            if (m_passes != NULL && next < std::min(hi, last))
             {
-                glm::vec3 v = p.pos - sp->origin;
-                p.pos = (r / sqrtf(r2 + d)) * v + sp->origin;
+                m_passes->integrate(next * cols, std::min(hi, last) * cols);
+                next = std::min(hi, last);
             }
+
+            SpringGrid w = g;
+            w.rows = hi - lo;
+            w.invmass = g.invmass + lo * cols;
+            w.src = offset_view(g.src, lo * cols);
+            
+            for (size_t k = 1; k <= num_iterations; ++k)
+            {
+                size_t halo = num_iterations - k;
+                size_t r0 = (t0 > halo) ? t0 - halo : 0;
+                size_t r1 = std::min(t1 + halo, rows);
+                
+                SpringError unused;
+                w.dst = (k == num_iterations)
+                    ? offset_view(g.dst, lo * cols)
+                    : window[k % 2];
+                m_kernels.relax_block(w, r0 - lo, r1 - lo, 0, cols,
+                                      (k == num_iterations) ? error : unused);
+                w.src = w.dst;
+            }
+
+            if (m_collide)
+                m_passes->collide(g.dst, t0 * cols, t1 * cols, thread_idx);
         }
+
+        m_control.next(thread_idx, (int)num_iterations - 1, error, barrier);
     }
+};
+
+/// Red-black Gauss-Seidel spring relaxation in place. Within a colour
+/// all points are independent, so the threads relax their bands of rows
+/// and only synchronize between colours.
+class RedBlackRelaxTask : public ParallelTask
+{
+    const SpringKernels &m_kernels;
+    const SpringGrid &m_grid;
+    IterationControl &m_control;
+    const TileSleep *m_sleep;
     
-}
+public:
+    RedBlackRelaxTask(const SpringKernels &kernels, const SpringGrid &grid,
+                      IterationControl &control, const TileSleep *sleep)
+        : m_kernels(kernels)
+        , m_grid(grid)
+        , m_control(control)
+        , m_sleep(sleep)
+    {
+    }
 
-static glm::vec3 solve_spring(const glm::vec3 &a, const glm::vec3 &b, float distance, float invmass_a, float invmass_b)
+    virtual void run(size_t thread_idx, size_t num_threads, Barrier &barrier)
+    {
+        size_t i0, i1;
+        partition_range(m_grid.rows, num_threads, thread_idx, &i0, &i1);
+
+        for (int iter = 0; iter < m_control.max_iterations(); ++iter)
+        {
+            SpringError error;
+            static const unsigned red = 0, black = 1;
+            relax_rows(m_kernels, m_grid, m_sleep, i0, i1, &red, error);
+            barrier.wait();
+            relax_rows(m_kernels, m_grid, m_sleep, i0, i1, &black, error);
+            if (!m_control.next(thread_idx, iter, error, barrier))
+                break;
+        }
+    }
+};
+
+/// Edge spring relaxation in place, one colour batch after another.
+/// The edges of a batch share no points, so the threads split each
+/// batch between them and only synchronize between batches.
+class EdgeRelaxTask : public ParallelTask
 {
-    float invmass_sum = invmass_a + invmass_b;
-    if (fabs(invmass_sum) < 1e-3)
-        return glm::vec3(0.0f);
+    const EdgeSprings &m_edges;
+    const Vec3Array &m_pos;
+    const float *m_invmass;
+    IterationControl &m_control;
+    float m_inv_dt2;
+    
+public:
+    EdgeRelaxTask(const EdgeSprings &edges, const Vec3Array &pos, const float *invmass,
+                  IterationControl &control)
+        : m_edges(edges)
+        , m_pos(pos)
+        , m_invmass(invmass)
+        , m_control(control)
+        , m_inv_dt2(-1.0f)
+    {
+    }
 
-    static const float stiffness = 0.6f;
+    /// Use XPBD with the edges' compliance for a step of `dt'
+    void set_compliant(float dt)
+    {
+        m_inv_dt2 = 1.0f / (dt * dt);
+    }
+
+    virtual void run(size_t thread_idx, size_t num_threads, Barrier &barrier)
+    {
+        size_t num_batches = m_edges.num_batches();
+        
+        for (int iter = 0; iter < m_control.max_iterations(); ++iter)
+        {
+            SpringError error;
+            for (size_t batch = 0; batch < num_batches; ++batch)
+            {
+                size_t begin = m_edges.batch_begin(batch);
+                size_t e0, e1;
+                partition_range(m_edges.batch_end(batch) - begin, num_threads, thread_idx,
+                                &e0, &e1);
+                if (m_inv_dt2 < 0.0f)
+                    m_edges.relax(m_pos, m_invmass, begin + e0, begin + e1, error);
+                else
+                    m_edges.relax_compliant(m_pos, m_invmass, m_inv_dt2,
+                                            begin + e0, begin + e1, error);
+                if (batch + 1 < num_batches)
+                    barrier.wait();
+            }
+            if (!m_control.next(thread_idx, iter, error, barrier))
+                break;
+        }
+    }
+};
+
+/// One multigrid V-cycle per iteration, in place
+class MultigridRelaxTask : public ParallelTask
+{
+    SpringMultigrid &m_multigrid;
+    const SpringKernels &m_kernels;
+    const SpringGrid &m_grid;
+    IterationControl &m_control;
     
-    glm::vec3 ab = b - a;
-    float l = sqrt(glm::dot(ab, ab));
-    float dl = (l - distance);
-    float delta;
-    if (l < 1e-2 || dl < 0.0f)
+public:
+    MultigridRelaxTask(SpringMultigrid &multigrid, const SpringKernels &kernels,
+                       const SpringGrid &grid, IterationControl &control)
+        : m_multigrid(multigrid)
+        , m_kernels(kernels)
+        , m_grid(grid)
+        , m_control(control)
     {
-        delta = 0.0f;
     }
-    else
+
+    virtual void run(size_t thread_idx, size_t num_threads, Barrier &barrier)
+    {
+        for (int iter = 0; iter < m_control.max_iterations(); ++iter)
+        {
+            SpringError error;
+            m_multigrid.v_cycle(m_kernels, m_grid, thread_idx, num_threads, barrier, error);
+            if (!m_control.next(thread_idx, iter, error, barrier))
+                break;
+        }
+    }
+};
+
+/// Projective dynamics iterations: the local step in bands of rows,
+/// the global step one coordinate per thread
+class ProjectiveTask : public ParallelTask
+{
+    ProjectiveSolver &m_solver;
+    const Vec3Array &m_pos;
+    size_t m_rows;
+    IterationControl &m_control;
+
+public:
+    ProjectiveTask(ProjectiveSolver &solver, const Vec3Array &pos, size_t rows,
+                   IterationControl &control)
+        : m_solver(solver)
+        , m_pos(pos)
+        , m_rows(rows)
+        , m_control(control)
     {
-        delta = (invmass_a * dl / (l * invmass_sum));
     }
-    return stiffness * delta * ab;
+
+    virtual void run(size_t thread_idx, size_t num_threads, Barrier &barrier)
+    {
+        size_t i0, i1;
+        partition_range(m_rows, num_threads, thread_idx, &i0, &i1);
+
+        for (int iter = 0; iter < m_control.max_iterations(); ++iter)
+        {
+            SpringError error;
+            m_solver.project(m_pos, i0, i1, error);
+            barrier.wait();
+            for (size_t axis = thread_idx; axis < 3; axis += num_threads)
+                m_solver.solve(m_pos, (int)axis);
+            if (!m_control.next(thread_idx, iter, error, barrier))
+                break;
+        }
+    }
+};
+
+} // namespace
+
+SpringGrid Cloth::spring_grid() const
+{
+    SpringGrid grid;
+    grid.rows = m_rows;
+    grid.cols = m_cols;
+    grid.dist_to_left = m_dist_to_left;
+    grid.dist_to_bottom = m_dist_to_bottom;
+    grid.stiffness = 0.6f;
+    grid.invmass = m_invmass;
+    return grid;
 }
 
-void Cloth::apply_spring_constraints()
+/// Returns whether the collisions have been handled too, which only
+/// the fused Jacobi solver does
+bool Cloth::apply_spring_constraints(float dt, const PointPasses *fused,
+                                     const TileSleep *sleep)
 {
-    static const int num_iterations = 4;
+    SpringGrid grid = spring_grid();
+    // XPBD takes one iteration per substep
+    bool xpbd = (m_spring_solver == SPRING_SOLVER_XPBD);
+    IterationControl control(m_pool->size(),
+                             xpbd ? 1 : m_spring_min_iterations,
+                             xpbd ? 1 : m_spring_max_iterations,
+                             m_spring_tolerance);
     
-    for (int iter = 0; iter < num_iterations; ++iter)
+    // every grid spring is counted from both ends, edges only once
+    size_t num_measured = 2 * (m_rows * (m_cols - 1) + m_cols * (m_rows - 1));
+    bool collided = false;
+    
+    if (m_spring_solver == SPRING_SOLVER_RED_BLACK)
     {
-        for (size_t i = 0; i < m_rows; ++i)
+        grid.src = grid.dst = m_points;
+        RedBlackRelaxTask task(*m_spring_kernels, grid, control, sleep);
+        m_pool->run(task);
+    }
+    else if (m_spring_solver == SPRING_SOLVER_EDGES || xpbd)
+    {
+        if (m_edges_dirty)
         {
-            for (size_t j = 0; j < m_cols; ++j)
-            {
-                size_t idx = i * m_cols + j;
-                Point &p = m_points[idx];
-                glm::vec3 dx = glm::vec3(0.0f);
-                if (i > 0)
-                    dx += solve_spring(p.pos, m_points[idx - m_cols].pos,
-                                       m_dist_to_bottom,
-                                       m_invmass[idx], m_invmass[idx - m_cols]);
-                if (j > 0) 
-                    dx += solve_spring(p.pos, m_points[idx - 1].pos,
-                                       m_dist_to_left,
-                                       m_invmass[idx], m_invmass[idx - 1]);
-                if (i < (m_rows - 1))
-                    dx += solve_spring(p.pos, m_points[idx + m_cols].pos,
-                                       m_dist_to_bottom,
-                                       m_invmass[idx], m_invmass[idx + m_cols]);
-                if (j < (m_cols - 1))
-                    dx += solve_spring(p.pos, m_points[idx + 1].pos,
-                                       m_dist_to_left,
-                                       m_invmass[idx], m_invmass[idx + 1]);
-                
-                m_spring_phase_buf[idx].pos = p.pos + dx;
-            }
+            m_edge_springs.build_grid(m_rows, m_cols, m_dist_to_left, m_dist_to_bottom,
+                                      m_edge_kinds, m_edge_stiffness, m_edge_compliance);
+            m_edges_dirty = false;
         }
+        
+        EdgeRelaxTask task(m_edge_springs, m_points, m_invmass, control);
+        if (xpbd)
+            task.set_compliant(dt);
+        m_pool->run(task);
+        num_measured = m_edge_springs.size();
+    }
+    else if (m_spring_solver == SPRING_SOLVER_PROJECTIVE)
+    {
+        m_projective->prepare(m_points, m_invmass, dt);
+        ProjectiveTask task(*m_projective, m_points, m_rows, control);
+        m_pool->run(task);
+    }
+    else if (m_spring_solver == SPRING_SOLVER_MULTIGRID)
+    {
+        grid.src = grid.dst = m_points;
+        MultigridRelaxTask task(*m_multigrid, *m_spring_kernels, grid, control);
+        m_pool->run(task);
+    }
+    else if (m_spring_tiling && m_chebyshev_rho == 0.0f && m_spring_max_iterations > 0 &&
+             m_spring_min_iterations == m_spring_max_iterations)
+    {
+        // windows of about half a typical L2 cache, counting the source,
+        // the two windows, the destination and the integration state
+        static const size_t cache_budget = 1024 * 1024;
+        size_t halo = m_spring_max_iterations;
+        size_t window_rows = std::max(cache_budget / (64 * m_cols), 4 * halo);
+        window_rows = std::min(window_rows, m_rows + 2 * halo);
+        update_tile_buffers(window_rows);
+        
+        grid.src = m_points;
+        grid.dst = m_spring_phase_buf;
+        TiledRelaxTask task(*m_spring_kernels, grid, control, m_tile_buffers,
+                            window_rows - 2 * halo);
+        collided = (fused != NULL && !m_long_range && m_self_collision == NULL);
+        if (fused != NULL)
+            task.set_fused(fused, collided);
+        m_pool->run(task);
         std::swap(m_points, m_spring_phase_buf);
     }
+    else
+    {
+        grid.src = m_points;
+        grid.dst = m_spring_phase_buf;
+        SpringRelaxTask task(*m_spring_kernels, grid, control);
+        task.set_sleep(sleep);
+        if (m_chebyshev_rho > 0.0f)
+            task.set_chebyshev(m_chebyshev_buf, m_chebyshev_rho);
+        // the last iteration is only known in advance without a
+        // tolerance; long-range attachments and self-collision come
+        // before the collisions
+        collided = (fused != NULL && m_spring_min_iterations == m_spring_max_iterations &&
+                    !m_long_range && m_self_collision == NULL);
+        if (fused != NULL)
+            task.set_fused(fused, collided);
+        m_pool->run(task);
+
+        if (task.result.x == m_spring_phase_buf.x)
+            std::swap(m_points, m_spring_phase_buf);
+        else if (task.result.x == m_chebyshev_buf.x)
+            std::swap(m_points, m_chebyshev_buf);
+    }
+
+    m_spring_stats.iterations = control.iterations_done;
+    m_spring_stats.max_error = control.error.max;
+    m_spring_stats.rms_error = (num_measured > 0)
+        ? (float)sqrt(control.error.sum_sq / num_measured)
+        : 0.0f;
+    return collided;
 }
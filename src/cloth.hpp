@@ -10,19 +10,77 @@
 #ifndef CLOTH_HPP__INCLUDED
 #define CLOTH_HPP__INCLUDED
 
+#include <vector>
+
 #include "surface.hpp"
 #include "world.hpp"
+#include "vec3_array.hpp"
+#include "quantized_vec3_array.hpp"
+#include "edge_springs.hpp"
+#include "memory_arena.hpp"
+#include "collider_table.hpp"
+
 
+struct SpringKernels;
+struct SpringGrid;
+struct PointPasses;
+class SpringMultigrid;
+class ImplicitSolver;
+class ProjectiveSolver;
+class TileSleep;
+class SelfCollision;
+class ThreadPool;
 
 class Cloth
 {
 public:
-    struct Point
+    enum SpringSolver
+    {
+        /// Double-buffered; every point is relaxed from the previous
+        /// iteration's positions
+        SPRING_SOLVER_JACOBI,
+        /// In place, alternating the two checkerboard colours of the grid.
+        /// Converges about twice as fast and needs no scratch buffer.
+        SPRING_SOLVER_RED_BLACK,
+        /// In place over an explicit list of springs in conflict-free
+        /// batches, see set_edge_springs(); each spring is solved once
+        SPRING_SOLVER_EDGES,
+        /// Red-black V-cycles over a hierarchy of coarsened grids, one
+        /// per iteration. Each costs about three red-black iterations but
+        /// spreads corrections across large grids much faster.
+        SPRING_SOLVER_MULTIGRID,
+        /// Projective dynamics with a prefactored global matrix, see
+        /// ProjectiveSolver; converges in a few iterations. The matrix is
+        /// refactored when the time step or the inverse masses change.
+        SPRING_SOLVER_PROJECTIVE,
+        /// XPBD over the edge springs with their compliance, one iteration
+        /// per substep; the stiffness does not depend on the time step or
+        /// the iteration count. Use with set_substeps().
+        SPRING_SOLVER_XPBD
+    };
+    
+    enum Integrator
     {
-        glm::vec3 pos;
+        /// Time-corrected Verlet followed by spring relaxation with the
+        /// selected SpringSolver; needs small steps for stiff cloth
+        INTEGRATOR_VERLET,
+        /// Backward Euler over the structural springs, solved with
+        /// conjugate gradients; stable at large steps, see ImplicitSolver
+        INTEGRATOR_IMPLICIT
     };
 
-    Cloth(float width, float height, size_t rows, size_t cols, const World &world);
+    enum PrevStorage
+    {
+        /// Previous positions as floats
+        PREV_STORAGE_FLOAT,
+        /// Previous positions as 16-bit offsets inside blocks of a row,
+        /// see QuantizedVec3Array. Saves 5 of 12 bytes per point; the
+        /// error is below 1e-5 of a block's extent.
+        PREV_STORAGE_QUANTIZED
+    };
+    
+    Cloth(float width, float height, size_t rows, size_t cols, const World &world,
+          PrevStorage prev_storage = PREV_STORAGE_FLOAT);
     ~Cloth();
 
     void lock();
@@ -30,24 +88,200 @@ public:
 
     void reset_velocity();
     
-    glm::vec3& pos_at(int i, int j) { return m_points[i * m_cols + j].pos; }
-    float& invmass_at(int i, int j) { return m_invmass[i * m_cols + j]; }
+    glm::vec3 pos_at(int i, int j) const { return m_points.get(i * m_cols + j); }
+    /// Also wakes the point's tile if it sleeps
+    void set_pos_at(int i, int j, const glm::vec3 &pos);
+    /// Writable inverse mass; 0 pins the point
+    float& invmass_at(int i, int j)
+    {
+        m_pins_dirty = true;
+        return m_invmass[i * m_cols + j];
+    }
+    float invmass_at(int i, int j) const { return m_invmass[i * m_cols + j]; }
     void draw();
 
+    /// Collides with the colliders last taken by World::update_colliders(),
+    /// which World::step() does first
     void step(float timestep);
 
+    /// Split every step into this many equal substeps, each integrating
+    /// and relaxing the springs once (1 by default)
+    void set_substeps(int substeps);
+    int substeps() const { return m_substeps; }
+
+    /// Select the integration and spring relaxation kernels by name:
+    /// "scalar", "sse2", "avx2" or "avx512", or "double" for a double
+    /// precision reference. Returns false if the name is unknown or the
+    /// CPU lacks the instructions. The widest supported set is the default.
+    bool set_spring_kernels(const char *name);
+    const char* spring_kernels() const;
+
+    void set_spring_solver(SpringSolver solver);
+    SpringSolver spring_solver() const { return m_spring_solver; }
+
+    /// Chebyshev semi-iterative acceleration of the Jacobi solver, given
+    /// an estimate of the spectral radius of the Jacobi iteration in
+    /// (0, 1). Higher estimates extrapolate more aggressively; too high
+    /// ones make the cloth jitter. Off by default.
+    void set_chebyshev(bool enabled, float spectral_radius);
+
+    /// Temporal tiling of the Jacobi solver: every tile of rows runs all
+    /// iterations in a small per-thread window before the next tile
+    /// starts, so that large grids stream through memory only once per
+    /// step. The results are identical. Only used with a fixed iteration
+    /// count and without Chebyshev acceleration. Off by default.
+    void set_spring_tiling(bool enabled);
+
+    /// Spring weight of the projective solver, 1e5 by default
+    void set_projective_stiffness(float stiffness);
+
+    /// Kinds of springs (EdgeSprings::Kind bits) used by the edge solver;
+    /// STRUCTURAL by default
+    void set_edge_springs(unsigned kinds);
+    /// Stiffness of one kind of edge spring, in (0, 1]. The defaults are
+    /// 0.6 for structural, 0.3 for shear and 0.1 for bend springs.
+    void set_edge_stiffness(EdgeSprings::Kind kind, float stiffness);
+    /// Compliance (inverse stiffness, m/N) of one kind of edge spring
+    /// for the XPBD solver. The defaults are 1e-7 for structural, 1e-6
+    /// for shear and 1e-4 for bend springs.
+    void set_edge_compliance(EdgeSprings::Kind kind, float compliance);
+
+    /// The spring relaxation runs at least `min_iterations' and at most
+    /// `max_iterations' per step, stopping in between as soon as the
+    /// largest relative spring stretch is below the tolerance. By default
+    /// it runs exactly 4 iterations.
+    void set_spring_iterations(int min_iterations, int max_iterations);
+    void set_spring_tolerance(float tolerance);
+
+    /// Spring solver statistics of the last step. The errors are relative
+    /// spring stretches measured during the last iteration, the
+    /// iterations are summed over all substeps. With the
+    /// implicit integrator they count CG iterations and the stretch
+    /// before the step.
+    struct SpringStats
+    {
+        int iterations;
+        float max_error;
+        float rms_error;
+    };
+    const SpringStats& spring_stats() const { return m_spring_stats; }
+
+    /// Estimated relative cost of the next step(): the awake points
+    /// times the spring iterations of the last step plus one for the
+    /// integration, or the iteration limit before the first step
+    double step_cost() const;
+
+    void set_integrator(Integrator integrator);
+    Integrator integrator() const { return m_integrator; }
+
+    /// Spring stiffness and stiffness-proportional damping (in seconds)
+    /// of the implicit integrator; 5000 and 0 by default
+    void set_implicit_springs(float stiffness, float damping);
+    /// Conjugate gradient iteration limit and relative residual
+    /// tolerance of the implicit integrator; 100 and 1e-3 by default
+    void set_implicit_solver(int max_iterations, float tolerance);
+
+    /// Long-range attachments: after the spring relaxation, every point
+    /// is pulled back to within its rest distance, measured along the
+    /// grid, from the nearest pin. Keeps the cloth far from the pins
+    /// from stretching at low iteration counts. Only used with the
+    /// Verlet integrator. Off by default.
+    void set_long_range_attachments(bool enabled);
+
+    /// Self-collision, see SelfCollision: points closer than `distance'
+    /// are pushed apart unless they are neighbours on the grid. A
+    /// distance of 0 takes the smaller spacing of the grid; it should
+    /// stay below twice that. Only used with the Verlet integrator. Off
+    /// by default.
+    void set_self_collision(bool enabled, float distance = 0.0f);
+
+    /// Let the resting parts of the cloth fall asleep, see TileSleep.
+    /// Points count as resting while they move less than `threshold'
+    /// per substep; sleeping ones are not integrated, relaxed or
+    /// collided. Only used with the Verlet integrator and the Jacobi
+    /// or red-black solver, without spring tiling. Off by default.
+    void set_sleeping(bool enabled, float threshold);
+    /// Tiles awake after the last step, and all tiles
+    size_t awake_tiles() const;
+    size_t num_tiles() const;
+
+    /// Number of threads the solver splits the grid across (default 1)
+    void set_num_threads(size_t num_threads);
+    size_t num_threads() const;
+
+    /// Bytes of the block holding the per-point buffers and the vertices
+    size_t arena_bytes() const { return m_arena.capacity(); }
+    bool arena_huge_pages() const { return m_arena.huge_pages(); }
+    PrevStorage prev_storage() const { return m_prev_storage; }
+
     size_t rows() { return m_rows; }
     size_t cols() { return m_cols; }
     float width() { return m_width; }
     float height() { return m_height; }
 
 private:
-    Point *m_points, *m_prev_points, *m_spring_phase_buf;
+    // The particle state and the surface vertices all live in one
+    // block; it comes first so that it is built before the surface.
+    MemoryArena m_arena;
+    
+    // Particle state, stored as separate x/y/z streams, and the Jacobi
+    // solver's scratch buffers. The scratch buffers and solver-specific
+    // state such as the coarse grids of the multigrid solver are
+    // allocated on demand; the former swap places with m_points.
+    Vec3Array m_points, m_prev_points, m_spring_phase_buf, m_chebyshev_buf;
+    // replaces m_prev_points with PREV_STORAGE_QUANTIZED
+    QuantizedVec3Array m_prev_quantized;
+    PrevStorage m_prev_storage;
     float *m_invmass;
+    // Points with zero inverse mass, and their positions saved at the
+    // start of a substep. Rebuilt when invmass_at() has been written.
+    std::vector<size_t> m_pinned;
+    std::vector<glm::vec3> m_pinned_pos, m_pinned_prev;
+    bool m_pins_dirty;
     bool m_locked;
     float m_prev_dt;
+    int m_substeps;
     glm::vec3 m_gravity;
+    Integrator m_integrator;
+    SpringSolver m_spring_solver;
+    int m_spring_min_iterations, m_spring_max_iterations;
+    float m_spring_tolerance;
+    float m_chebyshev_rho;
+    bool m_spring_tiling;
+    // two tile windows per thread for the tiled Jacobi solver
+    std::vector<Vec3Array> m_tile_buffers;
+    size_t m_tile_window_rows;
+    SpringStats m_spring_stats;
+    TileSleep *m_sleep;
+    float m_sleep_threshold;
+    // tiles that fell asleep in the last substep
+    std::vector<size_t> m_fell_asleep;
+    bool m_long_range;
+    // for each point, its nearest pin (an index into m_pinned) and the
+    // distance to it along the grid; rebuilt with the pins
+    std::vector<unsigned> m_attach_pin;
+    std::vector<float> m_attach_dist;
+    SelfCollision *m_self_collision;
+    
+    EdgeSprings m_edge_springs;
+    unsigned m_edge_kinds;
+    float m_edge_stiffness[EdgeSprings::num_kinds];
+    float m_edge_compliance[EdgeSprings::num_kinds];
+    bool m_edges_dirty;
+    SpringMultigrid *m_multigrid;
+    ProjectiveSolver *m_projective;
+    float m_projective_stiffness;
+    ImplicitSolver *m_implicit;
+    float m_implicit_stiffness, m_implicit_damping;
+    int m_implicit_max_iterations;
+    float m_implicit_tolerance;
+    const SpringKernels *m_spring_kernels;
+    ThreadPool *m_pool;
+    // one per thread, for the spheres a run of points may touch
+    mutable std::vector<std::vector<unsigned> > m_sphere_buffers;
     const World &m_world;
+    // the colliders of m_world, taken at the start of each step
+    const ColliderTable &m_colliders;
     Surface m_surface;
     
     float m_width, m_height;
@@ -59,10 +293,26 @@ private:
     void upload();
 
     void copy_current_to_prev();
+    void update_pins();
+    void update_attachments();
+    void save_pinned();
+    glm::vec3 prev_at(size_t idx) const;
+    PointPasses point_passes(float dt, const TileSleep *sleep) const;
+    TileSleep* active_sleep();
+    void update_sleep();
+    
+    void substep(float dt);
+    void step_implicit(float dt);
+    static size_t arena_size(size_t rows, size_t cols, PrevStorage prev_storage);
+    void update_solver_buffers();
+    void allocate_solver_buffer(Vec3Array &buf);
+    void release_solver_buffer(Vec3Array &buf);
+    void update_tile_buffers(size_t window_rows);
+
+    bool apply_spring_constraints(float dt, const PointPasses *fused,
+                                  const TileSleep *sleep);
 
-    void apply_plane_constraints();
-    void apply_sphere_constraints();
-    void apply_spring_constraints();
+    SpringGrid spring_grid() const;
 };
 
 #endif // CLOTH_HPP__INCLUDED
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include "collider_table.hpp"
+#include "world.hpp"
+
+
+void ColliderTable::build(const World &world)
+{
+    size_t num_planes = world.planes.size();
+    plane_nx.resize(num_planes);
+    plane_ny.resize(num_planes);
+    plane_nz.resize(num_planes);
+    plane_d.resize(num_planes);
+    for (size_t k = 0; k < num_planes; ++k)
+    {
+        const Plane &pl = world.planes[k];
+        plane_nx[k] = pl.n.x;
+        plane_ny[k] = pl.n.y;
+        plane_nz[k] = pl.n.z;
+        plane_d[k] = pl.d;
+    }
+
+    size_t num_spheres = world.spheres.size();
+    sphere_x.resize(num_spheres);
+    sphere_y.resize(num_spheres);
+    sphere_z.resize(num_spheres);
+    sphere_r.resize(num_spheres);
+    for (size_t k = 0; k < num_spheres; ++k)
+    {
+        const Sphere &sp = world.spheres[k];
+        sphere_x[k] = sp.origin.x;
+        sphere_y[k] = sp.origin.y;
+        sphere_z[k] = sp.origin.z;
+        sphere_r[k] = sp.r;
+    }
+}
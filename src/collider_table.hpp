@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef COLLIDER_TABLE_HPP__INCLUDED
+#define COLLIDER_TABLE_HPP__INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+struct World;
+
+/// The colliders of a world packed into structure-of-arrays streams,
+/// in the order of the world's arrays.
+///
+/// Taken by World::update_colliders() at the start of a step, once for
+/// all cloths, so that the collision pass reads contiguous floats
+/// instead of following a pointer per collider, and the world may
+/// change meanwhile without affecting the step.
+struct ColliderTable
+{
+    std::vector<float> plane_nx, plane_ny, plane_nz, plane_d;
+    std::vector<float> sphere_x, sphere_y, sphere_z, sphere_r;
+
+    void build(const World &world);
+
+    size_t num_planes() const { return plane_d.size(); }
+    size_t num_spheres() const { return sphere_r.size(); }
+
+    /// The lowest value of the equation of plane `k' over the box [lo, hi]
+    float plane_min_equ(size_t k, const glm::vec3 &lo, const glm::vec3 &hi) const
+    {
+        glm::vec3 centre = (lo + hi) * 0.5f;
+        glm::vec3 half = (hi - lo) * 0.5f;
+        glm::vec3 n(plane_nx[k], plane_ny[k], plane_nz[k]);
+        return glm::dot(n, centre) + plane_d[k] - glm::dot(glm::abs(n), half);
+    }
+
+    /// Squared distance from the centre of sphere `k' to the box [lo, hi]
+    float sphere_box_dist2(size_t k, const glm::vec3 &lo, const glm::vec3 &hi) const
+    {
+        glm::vec3 o(sphere_x[k], sphere_y[k], sphere_z[k]);
+        glm::vec3 v = glm::clamp(o, lo, hi) - o;
+        return glm::dot(v, v);
+    }
+};
+
+#endif // COLLIDER_TABLE_HPP__INCLUDED
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <cassert>
+#include <cmath>
+
+#include "edge_springs.hpp"
+#include "simd/springs.hpp"
+
+
+EdgeSprings::EdgeSprings()
+{
+    m_batch_start.push_back(0);
+}
+
+void EdgeSprings::add(unsigned a, unsigned b, float rest, float stiffness, float compliance)
+{
+    m_a.push_back(a);
+    m_b.push_back(b);
+    m_rest.push_back(rest);
+    m_stiffness.push_back(stiffness);
+    m_compliance.push_back(compliance);
+}
+
+void EdgeSprings::build_grid(size_t rows, size_t cols,
+                             float dist_to_left, float dist_to_bottom,
+                             unsigned kinds, const float stiffness[num_kinds],
+                             const float compliance[num_kinds])
+{
+    m_a.clear();
+    m_b.clear();
+    m_rest.clear();
+    m_stiffness.clear();
+    m_compliance.clear();
+
+    float diagonal = sqrtf(dist_to_left * dist_to_left +
+                           dist_to_bottom * dist_to_bottom);
+    
+    for (size_t i = 0; i < rows; ++i)
+    {
+        for (size_t j = 0; j < cols; ++j)
+        {
+            unsigned idx = (unsigned)(i * cols + j);
+            
+            if (kinds & STRUCTURAL)
+            {
+                if (j + 1 < cols)
+                    add(idx, idx + 1, dist_to_left, stiffness[0], compliance[0]);
+                if (i + 1 < rows)
+                    add(idx, idx + cols, dist_to_bottom, stiffness[0], compliance[0]);
+            }
+            if ((kinds & SHEAR) && i + 1 < rows)
+            {
+                if (j + 1 < cols)
+                    add(idx, idx + cols + 1, diagonal, stiffness[1], compliance[1]);
+                if (j > 0)
+                    add(idx, idx + cols - 1, diagonal, stiffness[1], compliance[1]);
+            }
+            if (kinds & BEND)
+            {
+                if (j + 2 < cols)
+                    add(idx, idx + 2, 2.0f * dist_to_left, stiffness[2], compliance[2]);
+                if (i + 2 < rows)
+                    add(idx, idx + 2 * cols, 2.0f * dist_to_bottom, stiffness[2], compliance[2]);
+            }
+        }
+    }
+
+    colour_batches(rows * cols);
+}
+
+void EdgeSprings::colour_batches(size_t num_points)
+{
+    // Greedy colouring: give every edge the lowest colour not yet used
+    // at either of its points. The grid springs need at most a dozen.
+    typedef unsigned long long colour_mask_t;
+    static const size_t max_colours = sizeof(colour_mask_t) * 8;
+    
+    std::vector<colour_mask_t> used(num_points, 0);
+    std::vector<unsigned> colour(m_a.size());
+    size_t num_colours = 0;
+    
+    for (size_t e = 0; e < m_a.size(); ++e)
+    {
+        colour_mask_t taken = used[m_a[e]] | used[m_b[e]];
+        unsigned c = 0;
+        while (taken & ((colour_mask_t)1 << c))
+            ++c;
+        assert(c < max_colours);
+        (void)max_colours;
+
+        colour[e] = c;
+        used[m_a[e]] |= (colour_mask_t)1 << c;
+        used[m_b[e]] |= (colour_mask_t)1 << c;
+        if (c + 1 > num_colours)
+            num_colours = c + 1;
+    }
+
+    // counting sort by colour, stable to keep the memory order in a batch
+    m_batch_start.assign(num_colours + 1, 0);
+    for (size_t e = 0; e < colour.size(); ++e)
+        ++m_batch_start[colour[e] + 1];
+    for (size_t c = 0; c < num_colours; ++c)
+        m_batch_start[c + 1] += m_batch_start[c];
+
+    std::vector<size_t> next(m_batch_start.begin(), m_batch_start.end() - 1);
+    std::vector<unsigned> a(m_a.size()), b(m_b.size());
+    std::vector<float> rest(m_rest.size()), stiffness(m_stiffness.size());
+    std::vector<float> compliance(m_compliance.size());
+    for (size_t e = 0; e < colour.size(); ++e)
+    {
+        size_t dst = next[colour[e]]++;
+        a[dst] = m_a[e];
+        b[dst] = m_b[e];
+        rest[dst] = m_rest[e];
+        stiffness[dst] = m_stiffness[e];
+        compliance[dst] = m_compliance[e];
+    }
+    m_a.swap(a);
+    m_b.swap(b);
+    m_rest.swap(rest);
+    m_stiffness.swap(stiffness);
+    m_compliance.swap(compliance);
+}
+
+void EdgeSprings::relax(const Vec3Array &pos, const float *invmass,
+                        size_t e0, size_t e1, SpringError &error) const
+{
+    float *x = pos.x, *y = pos.y, *z = pos.z;
+    
+    for (size_t e = e0; e < e1; ++e)
+    {
+        unsigned a = m_a[e], b = m_b[e];
+        float invmass_a = invmass[a], invmass_b = invmass[b];
+        float invmass_sum = invmass_a + invmass_b;
+        if (invmass_sum < 1e-3f)
+            continue;
+
+        float abx = x[b] - x[a];
+        float aby = y[b] - y[a];
+        float abz = z[b] - z[a];
+        float l = sqrtf(abx * abx + aby * aby + abz * abz);
+        float dl = l - m_rest[e];
+        // like the grid springs, these only pull
+        if (l < 1e-2f || dl < 0.0f)
+            continue;
+
+        float stretch = dl / m_rest[e];
+        if (stretch > error.max)
+            error.max = stretch;
+        error.sum_sq += stretch * stretch;
+
+        float k = m_stiffness[e] * dl / (l * invmass_sum);
+        float ka = k * invmass_a, kb = k * invmass_b;
+        x[a] += ka * abx;
+        y[a] += ka * aby;
+        z[a] += ka * abz;
+        x[b] -= kb * abx;
+        y[b] -= kb * aby;
+        z[b] -= kb * abz;
+    }
+}
+
+void EdgeSprings::relax_compliant(const Vec3Array &pos, const float *invmass, float inv_dt2,
+                                  size_t e0, size_t e1, SpringError &error) const
+{
+    float *x = pos.x, *y = pos.y, *z = pos.z;
+    
+    for (size_t e = e0; e < e1; ++e)
+    {
+        unsigned a = m_a[e], b = m_b[e];
+        float invmass_a = invmass[a], invmass_b = invmass[b];
+        float invmass_sum = invmass_a + invmass_b;
+        if (invmass_sum == 0.0f)
+            continue;
+
+        float abx = x[b] - x[a];
+        float aby = y[b] - y[a];
+        float abz = z[b] - z[a];
+        float l = sqrtf(abx * abx + aby * aby + abz * abz);
+        float dl = l - m_rest[e];
+        if (l < 1e-6f || dl < 0.0f)
+            continue;
+
+        float stretch = dl / m_rest[e];
+        if (stretch > error.max)
+            error.max = stretch;
+        error.sum_sq += stretch * stretch;
+
+        // delta lambda = -C / (w_a + w_b + alpha / dt^2), lambda being 0
+        float k = dl / (l * (invmass_sum + m_compliance[e] * inv_dt2));
+        float ka = k * invmass_a, kb = k * invmass_b;
+        x[a] += ka * abx;
+        y[a] += ka * aby;
+        z[a] += ka * abz;
+        x[b] -= kb * abx;
+        y[b] -= kb * aby;
+        z[b] -= kb * abz;
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef EDGE_SPRINGS_HPP__INCLUDED
+#define EDGE_SPRINGS_HPP__INCLUDED
+
+#include <vector>
+
+#include "vec3_array.hpp"
+
+
+struct SpringError;
+
+/// An explicit list of springs between pairs of grid points, each with
+/// its own rest length, stiffness and compliance.
+///
+/// The edges are coloured so that no two edges of the same colour share
+/// a point, and stored sorted by colour. Each colour is a batch that can
+/// be relaxed in place and in any order, or split across threads.
+class EdgeSprings
+{
+public:
+    enum Kind
+    {
+        STRUCTURAL = 1 << 0,  ///< to the 4 direct neighbours
+        SHEAR      = 1 << 1,  ///< along the cell diagonals
+        BEND       = 1 << 2   ///< to the points two rows/columns away
+    };
+    static const int num_kinds = 3;
+
+    EdgeSprings();
+
+    /// Build the springs of a rows x cols grid of the given kinds, with
+    /// the rest lengths of a flat sheet; stiffness and compliance are
+    /// indexed by kind bit
+    void build_grid(size_t rows, size_t cols, float dist_to_left, float dist_to_bottom,
+                    unsigned kinds, const float stiffness[num_kinds],
+                    const float compliance[num_kinds]);
+
+    size_t size() const { return m_a.size(); }
+    size_t num_batches() const { return m_batch_start.size() - 1; }
+    size_t batch_begin(size_t batch) const { return m_batch_start[batch]; }
+    size_t batch_end(size_t batch) const { return m_batch_start[batch + 1]; }
+
+    /// Relax edges [e0, e1) in place. The correction of each spring is
+    /// computed once and split between both ends by inverse mass.
+    void relax(const Vec3Array &pos, const float *invmass,
+               size_t e0, size_t e1, SpringError &error) const;
+
+    /// One XPBD iteration over edges [e0, e1) in place for a time step
+    /// with 1 / dt^2 = `inv_dt2', see Macklin et al., "XPBD:
+    /// Position-Based Simulation of Compliant Constrained Dynamics", 2016.
+    /// Only meant for a single iteration per step, where the Lagrange
+    /// multipliers start at zero and need not be kept.
+    void relax_compliant(const Vec3Array &pos, const float *invmass, float inv_dt2,
+                         size_t e0, size_t e1, SpringError &error) const;
+
+private:
+    std::vector<unsigned> m_a, m_b;
+    std::vector<float> m_rest, m_stiffness, m_compliance;
+    std::vector<size_t> m_batch_start;
+
+    void add(unsigned a, unsigned b, float rest, float stiffness, float compliance);
+    void colour_batches(size_t num_points);
+};
+
+#endif // EDGE_SPRINGS_HPP__INCLUDED
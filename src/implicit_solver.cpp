@@ -0,0 +1,422 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <new>
+
+#include "memory.hpp"
+#include "thread_pool.hpp"
+#include "implicit_solver.hpp"
+
+
+static float* alloc_floats(size_t size)
+{
+    void *res = aligned_malloc(std::max<size_t>(size, 1) * sizeof(float), simd_alignment);
+    if (res == NULL)
+        throw std::bad_alloc();
+    std::fill((float*)res, (float*)res + size, 0.0f);
+    return (float*)res;
+}
+
+void ImplicitSolver::SpringSet::allocate(size_t size)
+{
+    dir.allocate(size);
+    iso = alloc_floats(size);
+    axial = alloc_floats(size);
+    tension = alloc_floats(size);
+}
+
+void ImplicitSolver::SpringSet::release()
+{
+    dir.release();
+    aligned_free(iso);
+    aligned_free(axial);
+    aligned_free(tension);
+}
+
+ImplicitSolver::ImplicitSolver(size_t rows, size_t cols,
+                               float dist_to_left, float dist_to_bottom)
+    : m_rows(rows)
+    , m_cols(cols)
+    , m_num_points(rows * cols)
+    , m_dist_to_left(dist_to_left)
+    , m_dist_to_bottom(dist_to_bottom)
+    , m_stiffness(5000.0f)
+    , m_damping(0.0f)
+    , m_max_iterations(100)
+    , m_tolerance(1e-3f)
+    , m_iterations(0)
+{
+    m_horizontal.allocate(m_num_points);
+    m_vertical.allocate(m_num_points);
+    m_vel.allocate(m_num_points);
+    m_dv.allocate(m_num_points);
+    m_r.allocate(m_num_points);
+    m_z.allocate(m_num_points);
+    m_p.allocate(m_num_points);
+    m_ap.allocate(m_num_points);
+    m_inv_diag.allocate(m_num_points);
+}
+
+ImplicitSolver::~ImplicitSolver()
+{
+    m_horizontal.release();
+    m_vertical.release();
+    m_vel.release();
+    m_dv.release();
+    m_r.release();
+    m_z.release();
+    m_p.release();
+    m_ap.release();
+    m_inv_diag.release();
+}
+
+void ImplicitSolver::set_springs(float stiffness, float damping)
+{
+    assert(stiffness > 0.0f && damping >= 0.0f);
+    m_stiffness = stiffness;
+    m_damping = damping;
+}
+
+void ImplicitSolver::set_iterations(int max_iterations, float tolerance)
+{
+    assert(max_iterations >= 1);
+    m_max_iterations = max_iterations;
+    m_tolerance = tolerance;
+}
+
+namespace {
+
+/// Product of a linearized spring's Jacobian with v
+static inline glm::vec3 spring_product(const Vec3Array &dir, const float *iso,
+                                       const float *axial, size_t s, const glm::vec3 &v)
+{
+    glm::vec3 u = dir.get(s);
+    return iso[s] * v + (axial[s] * glm::dot(u, v)) * u;
+}
+
+/// Sums of two per-thread values, the same on every thread. The slots
+/// alternate between calls so that a thread may post the next sum while
+/// others still read the current one.
+class Reduction
+{
+    std::vector<double> m_slots[2];
+    size_t m_num_threads;
+
+public:
+    explicit Reduction(size_t num_threads)
+        : m_num_threads(num_threads)
+    {
+        m_slots[0].resize(2 * num_threads);
+        m_slots[1].resize(2 * num_threads);
+    }
+
+    /// Every thread calls it the same number of times, counting the
+    /// calls in its own `generation'
+    void sum(size_t thread_idx, double a, double b, Barrier &barrier,
+             double *sum_a, double *sum_b, int *generation)
+    {
+        std::vector<double> &slots = m_slots[*generation % 2];
+        ++*generation;
+        slots[2 * thread_idx] = a;
+        slots[2 * thread_idx + 1] = b;
+        barrier.wait();
+
+        *sum_a = *sum_b = 0.0;
+        for (size_t t = 0; t < m_num_threads; ++t)
+        {
+            *sum_a += slots[2 * t];
+            *sum_b += slots[2 * t + 1];
+        }
+    }
+};
+
+} // namespace
+
+class ImplicitSolver::StepTask : public ParallelTask
+{
+    ImplicitSolver &m_solver;
+    const Vec3Array &m_pos, &m_prev_pos;
+    const float *m_invmass;
+    glm::vec3 m_gravity;
+    float m_dt, m_prev_dt;
+    Reduction m_reduction;
+    std::vector<SpringError> m_stretch;
+
+public:
+    int iterations;
+    SpringError stretch;
+    
+    StepTask(ImplicitSolver &solver, size_t num_threads,
+             const Vec3Array &pos, const Vec3Array &prev_pos, const float *invmass,
+             const glm::vec3 &gravity, float dt, float prev_dt)
+        : m_solver(solver)
+        , m_pos(pos)
+        , m_prev_pos(prev_pos)
+        , m_invmass(invmass)
+        , m_gravity(gravity)
+        , m_dt(dt)
+        , m_prev_dt(prev_dt)
+        , m_reduction(num_threads)
+        , m_stretch(num_threads)
+        , iterations(0)
+    {
+    }
+
+    virtual void run(size_t thread_idx, size_t num_threads, Barrier &barrier)
+    {
+        ImplicitSolver &s = m_solver;
+        size_t i0, i1;
+        partition_range(s.m_rows, num_threads, thread_idx, &i0, &i1);
+        size_t begin = i0 * s.m_cols, end = i1 * s.m_cols;
+        int generation = 0;
+        
+        linearize(i0, i1, m_stretch[thread_idx]);
+        barrier.wait();
+
+        // r = b - A 0, z = P r, p = z
+        double rz = 0.0, rr = 0.0;
+        for (size_t i = i0; i < i1; ++i)
+        {
+            for (size_t j = 0; j < s.m_cols; ++j)
+            {
+                size_t idx = i * s.m_cols + j;
+                glm::vec3 r = rhs(i, j);
+                glm::vec3 z = r * s.m_inv_diag.get(idx);
+                s.m_dv.set(idx, glm::vec3(0.0f));
+                s.m_r.set(idx, r);
+                s.m_z.set(idx, z);
+                s.m_p.set(idx, z);
+                rz += glm::dot(r, z);
+                rr += glm::dot(r, r);
+            }
+        }
+        double rhs_rr;
+        m_reduction.sum(thread_idx, rz, rr, barrier, &rz, &rhs_rr, &generation);
+        double threshold = (double)s.m_tolerance * s.m_tolerance * rhs_rr;
+
+        int iter = 0;
+        rr = rhs_rr;
+        while (iter < s.m_max_iterations && rr > threshold)
+        {
+            double pap = 0.0, unused;
+            for (size_t i = i0; i < i1; ++i)
+            {
+                for (size_t j = 0; j < s.m_cols; ++j)
+                {
+                    size_t idx = i * s.m_cols + j;
+                    glm::vec3 ap = product(s.m_p, i, j);
+                    s.m_ap.set(idx, ap);
+                    pap += glm::dot(s.m_p.get(idx), ap);
+                }
+            }
+            m_reduction.sum(thread_idx, pap, 0.0, barrier, &pap, &unused, &generation);
+            if (pap <= 0.0)
+                break;
+            float alpha = (float)(rz / pap);
+
+            double rz_new = 0.0;
+            rr = 0.0;
+            for (size_t idx = begin; idx < end; ++idx)
+            {
+                glm::vec3 r = s.m_r.get(idx) - alpha * s.m_ap.get(idx);
+                glm::vec3 z = r * s.m_inv_diag.get(idx);
+                s.m_dv.set(idx, s.m_dv.get(idx) + alpha * s.m_p.get(idx));
+                s.m_r.set(idx, r);
+                s.m_z.set(idx, z);
+                rz_new += glm::dot(r, z);
+                rr += glm::dot(r, r);
+            }
+            m_reduction.sum(thread_idx, rz_new, rr, barrier, &rz_new, &rr, &generation);
+            ++iter;
+
+            float beta = (float)(rz_new / rz);
+            rz = rz_new;
+            for (size_t idx = begin; idx < end; ++idx)
+                s.m_p.set(idx, s.m_z.get(idx) + beta * s.m_p.get(idx));
+            // the next product reads the neighbours' p
+            barrier.wait();
+        }
+
+        for (size_t idx = begin; idx < end; ++idx)
+        {
+            if (m_invmass[idx] == 0.0f)
+                continue;
+            glm::vec3 x = m_pos.get(idx);
+            glm::vec3 v = s.m_vel.get(idx) + s.m_dv.get(idx);
+            m_prev_pos.set(idx, x);
+            m_pos.set(idx, x + m_dt * v);
+        }
+
+        if (thread_idx == 0)
+        {
+            // the other threads have posted theirs before the first sum
+            iterations = iter;
+            for (size_t t = 0; t < num_threads; ++t)
+                stretch.merge(m_stretch[t]);
+        }
+    }
+
+private:
+    /// Velocities and linearized springs of rows [i0, i1)
+    void linearize(size_t i0, size_t i1, SpringError &error)
+    {
+        ImplicitSolver &s = m_solver;
+        float inv_prev_dt = 1.0f / m_prev_dt;
+        
+        for (size_t i = i0; i < i1; ++i)
+        {
+            for (size_t j = 0; j < s.m_cols; ++j)
+            {
+                size_t idx = i * s.m_cols + j;
+                glm::vec3 x = m_pos.get(idx);
+                s.m_vel.set(idx, (x - m_prev_pos.get(idx)) * inv_prev_dt);
+                
+                if (j + 1 < s.m_cols)
+                    linearize_spring(s.m_horizontal, idx, x, m_pos.get(idx + 1),
+                                     s.m_dist_to_left, error);
+                if (i + 1 < s.m_rows)
+                    linearize_spring(s.m_vertical, idx, x, m_pos.get(idx + s.m_cols),
+                                     s.m_dist_to_bottom, error);
+            }
+        }
+    }
+
+    void linearize_spring(SpringSet &set, size_t s, const glm::vec3 &a, const glm::vec3 &b,
+                          float rest, SpringError &error)
+    {
+        float k = m_solver.m_stiffness;
+        glm::vec3 ab = b - a;
+        float l = glm::length(ab);
+        
+        if (l < 1e-6f)
+        {
+            set.dir.set(s, glm::vec3(0.0f));
+            set.iso[s] = set.axial[s] = set.tension[s] = 0.0f;
+            return;
+        }
+        set.dir.set(s, ab / l);
+        
+        if (l <= rest)
+        {
+            // a slack spring exerts no force, but keeps its axial
+            // stiffness so that the step cannot overstretch it
+            set.iso[s] = set.tension[s] = 0.0f;
+            set.axial[s] = k;
+            return;
+        }
+        
+        float stretch = (l - rest) / rest;
+        error.max = std::max(error.max, stretch);
+        error.sum_sq += stretch * stretch;
+
+        set.iso[s] = k * (1.0f - rest / l);
+        set.axial[s] = k - set.iso[s];
+        set.tension[s] = k * (l - rest);
+    }
+
+    /// K v at point (i, j)
+    glm::vec3 stiffness_product(const Vec3Array &v, size_t i, size_t j) const
+    {
+        const ImplicitSolver &s = m_solver;
+        const SpringSet &h = s.m_horizontal, &vt = s.m_vertical;
+        size_t cols = s.m_cols;
+        size_t idx = i * cols + j;
+        glm::vec3 vi = v.get(idx);
+        glm::vec3 res(0.0f);
+        
+        if (j > 0)
+            res += spring_product(h.dir, h.iso, h.axial, idx - 1, vi - v.get(idx - 1));
+        if (j + 1 < cols)
+            res += spring_product(h.dir, h.iso, h.axial, idx, vi - v.get(idx + 1));
+        if (i > 0)
+            res += spring_product(vt.dir, vt.iso, vt.axial, idx - cols, vi - v.get(idx - cols));
+        if (i + 1 < s.m_rows)
+            res += spring_product(vt.dir, vt.iso, vt.axial, idx, vi - v.get(idx + cols));
+        return res;
+    }
+
+    /// Coefficient of K in the system matrix
+    float stiffness_weight() const
+    {
+        return m_dt * (m_dt + m_solver.m_damping);
+    }
+
+    /// A v at point (i, j); identity on fixed points
+    glm::vec3 product(const Vec3Array &v, size_t i, size_t j) const
+    {
+        size_t idx = i * m_solver.m_cols + j;
+        float invmass = m_invmass[idx];
+        if (invmass == 0.0f)
+            return v.get(idx);
+        return v.get(idx) / invmass + stiffness_weight() * stiffness_product(v, i, j);
+    }
+
+    /// Right hand side at point (i, j), and the inverse diagonal of A
+    glm::vec3 rhs(size_t i, size_t j)
+    {
+        ImplicitSolver &s = m_solver;
+        const SpringSet &h = s.m_horizontal, &vt = s.m_vertical;
+        size_t cols = s.m_cols;
+        size_t idx = i * cols + j;
+        float invmass = m_invmass[idx];
+        
+        if (invmass == 0.0f)
+        {
+            s.m_inv_diag.set(idx, glm::vec3(1.0f));
+            return glm::vec3(0.0f);
+        }
+
+        glm::vec3 force = m_gravity / invmass;
+        glm::vec3 diag(0.0f);
+        if (j > 0)
+        {
+            force -= h.tension[idx - 1] * h.dir.get(idx - 1);
+            diag += spring_diagonal(h, idx - 1);
+        }
+        if (j + 1 < cols)
+        {
+            force += h.tension[idx] * h.dir.get(idx);
+            diag += spring_diagonal(h, idx);
+        }
+        if (i > 0)
+        {
+            force -= vt.tension[idx - cols] * vt.dir.get(idx - cols);
+            diag += spring_diagonal(vt, idx - cols);
+        }
+        if (i + 1 < s.m_rows)
+        {
+            force += vt.tension[idx] * vt.dir.get(idx);
+            diag += spring_diagonal(vt, idx);
+        }
+
+        diag = glm::vec3(1.0f / invmass) + stiffness_weight() * diag;
+        s.m_inv_diag.set(idx, 1.0f / diag);
+
+        return m_dt * (force - (m_dt + s.m_damping) * stiffness_product(s.m_vel, i, j));
+    }
+
+    static glm::vec3 spring_diagonal(const SpringSet &set, size_t s)
+    {
+        glm::vec3 u = set.dir.get(s);
+        return glm::vec3(set.iso[s]) + set.axial[s] * u * u;
+    }
+};
+
+void ImplicitSolver::step(ThreadPool &pool, const Vec3Array &pos, const Vec3Array &prev_pos,
+                          const float *invmass, const glm::vec3 &gravity,
+                          float dt, float prev_dt)
+{
+    StepTask task(*this, pool.size(), pos, prev_pos, invmass, gravity, dt, prev_dt);
+    pool.run(task);
+    m_iterations = task.iterations;
+    m_stretch = task.stretch;
+}
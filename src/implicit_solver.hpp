@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef IMPLICIT_SOLVER_HPP__INCLUDED
+#define IMPLICIT_SOLVER_HPP__INCLUDED
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vec3_array.hpp"
+#include "simd/springs.hpp"
+
+
+class ThreadPool;
+
+/// Backward Euler integration of the structural springs of a grid, as
+/// in Baraff and Witkin, "Large Steps in Cloth Simulation", 1998.
+///
+/// Each step linearizes the spring forces around the current positions
+/// and solves (M + h (h + d) K) dv = h (f - (h + d) K v) for the velocity
+/// change with preconditioned conjugate gradients. K is never assembled;
+/// its products are gathered from the four neighbours of every point.
+/// Springs only pull, like in the relaxation solvers, which keeps the
+/// system positive definite. Points of zero inverse mass are fixed.
+class ImplicitSolver
+{
+public:
+    ImplicitSolver(size_t rows, size_t cols, float dist_to_left, float dist_to_bottom);
+    ~ImplicitSolver();
+
+    /// Spring stiffness k and stiffness-proportional damping d (seconds)
+    void set_springs(float stiffness, float damping);
+    /// CG stops after `max_iterations' or once the residual norm drops
+    /// below `tolerance' times the right hand side norm
+    void set_iterations(int max_iterations, float tolerance);
+
+    /// Advance `pos' by `dt'. The velocities are taken from `prev_pos'
+    /// and `prev_dt', which is then updated like the Verlet integrator
+    /// does, so that the two can be switched between steps.
+    void step(ThreadPool &pool, const Vec3Array &pos, const Vec3Array &prev_pos,
+              const float *invmass, const glm::vec3 &gravity, float dt, float prev_dt);
+
+    /// CG iterations run by the last step
+    int iterations() const { return m_iterations; }
+    /// Relative spring stretch at the beginning of the last step
+    const SpringError& stretch() const { return m_stretch; }
+
+private:
+    /// Linearized springs to the right (or below) of every point
+    struct SpringSet
+    {
+        /// Unit direction of the spring
+        Vec3Array dir;
+        /// The spring Jacobian is iso * I + axial * dir dir^T
+        float *iso, *axial;
+        /// Force magnitude pulling the ends together
+        float *tension;
+
+        void allocate(size_t size);
+        void release();
+    };
+    
+    size_t m_rows, m_cols, m_num_points;
+    float m_dist_to_left, m_dist_to_bottom;
+    float m_stiffness, m_damping;
+    int m_max_iterations;
+    float m_tolerance;
+
+    SpringSet m_horizontal, m_vertical;
+    // velocity, solution, CG vectors and inverse preconditioner
+    Vec3Array m_vel, m_dv, m_r, m_z, m_p, m_ap, m_inv_diag;
+
+    int m_iterations;
+    SpringError m_stretch;
+
+    class StepTask;
+};
+
+#endif // IMPLICIT_SOLVER_HPP__INCLUDED
@@ -24,10 +24,13 @@
 #include "script.hpp"
 #include "surface.hpp"
 #include "math_utils.hpp"
+#include "thread_pool.hpp"
 
 
 World *g_world = NULL;
+// the cloth reset() puts back in place; owned by g_world
 Cloth *g_cloth = NULL;
+ThreadPool *g_pool = NULL;
 Script *g_script = NULL;
 Surface *g_plane_surface = NULL;
 
@@ -88,10 +91,9 @@ void reset()
         {
             float fj = (float)j / (cols - 1);
 
-            glm::vec3 &p = c.pos_at(i, j);
-            p.x = fi * height - height_half;
-            p.y = 0.5f;
-            p.z = fj * width - width_half;
+            c.set_pos_at(i, j, glm::vec3(fi * height - height_half,
+                                         0.5f,
+                                         fj * width - width_half));
         }
     }
     c.invmass_at(0, 0) = 0.0f;
@@ -158,7 +160,7 @@ static void do_render(bool alt_color)
     for (World::sphere_array_t::const_iterator it = g_world->spheres.begin();
          it != g_world->spheres.end(); ++it)
     {
-        Sphere *sp = *it;
+        const Sphere *sp = &*it;
         glPushMatrix();
         glTranslatef(sp->origin.x, sp->origin.y, sp->origin.z);
         glutSolidSphere(sp->r - sphere_r_bias, 20, 20);
@@ -168,7 +170,7 @@ static void do_render(bool alt_color)
     for (World::plane_array_t::const_iterator it = g_world->planes.begin();
          it != g_world->planes.end(); ++it)
     {
-        Plane *pl = *it;
+        const Plane *pl = &*it;
         glPushMatrix();
         glm::vec3 offset = -pl->n * pl->d;
         glTranslatef(offset.x, offset.y, offset.z);
@@ -183,7 +185,11 @@ static void do_render(bool alt_color)
     else
         glColor3f(0.75f, 0.3f, 0.25f);
     
-    g_cloth->draw();
+    for (World::cloth_array_t::const_iterator it = g_world->cloths.begin();
+         it != g_world->cloths.end(); ++it)
+    {
+        (*it)->draw();
+    }
 }
 
 void render()
@@ -226,13 +232,16 @@ void update()
 
     if (g_update)
     {
-        g_cloth->lock();
+        World::cloth_array_t &cloths = g_world->cloths;
+        for (size_t i = 0; i < cloths.size(); ++i)
+            cloths[i]->lock();
         if (g_script != NULL)
         {
             g_script->update(0.01f);
         }
-        g_cloth->step(0.01f);
-        g_cloth->unlock();
+        g_world->step(*g_pool, 0.01f);
+        for (size_t i = 0; i < cloths.size(); ++i)
+            cloths[i]->unlock();
     }
     
     glutPostRedisplay();
@@ -272,19 +281,21 @@ int main(int argc, char *argv[])
     REQUIRE_EXTENSION("GL_ARB_vertex_buffer_object");
 
     g_world = new World();
-    /*g_world->planes.push_back(Plane(glm::vec3(-1.0f, 0.5f, -1.0f),
-                                    glm::vec3(-1.0f, 0.5f, 1.0f),
-                                    glm::vec3(1.0f, -0.5f, 1.0f)));*/
+    /*g_world->planes.insert(Plane(glm::vec3(-1.0f, 0.5f, -1.0f),
+                                 glm::vec3(-1.0f, 0.5f, 1.0f),
+                                 glm::vec3(1.0f, -0.5f, 1.0f)));*/
 
-    /*g_world->planes.push_back(new Plane(glm::vec3(0.0f, -0.9f, 0.0f),
-                                        glm::vec3(0.0f, -0.9f, 1.0f),
-                                        glm::vec3(1.0f, -0.9f, 0.0f)));*/
+    /*g_world->planes.insert(Plane(glm::vec3(0.0f, -0.9f, 0.0f),
+                                 glm::vec3(0.0f, -0.9f, 1.0f),
+                                 glm::vec3(1.0f, -0.9f, 0.0f)));*/
 
-    /*g_world->planes.push_back(Plane(glm::vec3(0.0f, 0.1f, 0.0f),
-                                    glm::vec3(1.0f, 0.1f, 0.0f),
-                                    glm::vec3(0.0f, 0.1f, 1.0f)));*/
+    /*g_world->planes.insert(Plane(glm::vec3(0.0f, 0.1f, 0.0f),
+                                 glm::vec3(1.0f, 0.1f, 0.0f),
+                                 glm::vec3(0.0f, 0.1f, 1.0f)));*/
     
+    g_pool = new ThreadPool(hardware_concurrency());
     g_cloth = new Cloth(2.0f, 2.0f, 32, 32, *g_world);
+    g_world->cloths.push_back(g_cloth);
     reset();
 
     if (argc > 1)
@@ -314,8 +325,8 @@ int main(int argc, char *argv[])
 
     glutMainLoop();
     
-    delete g_cloth;
     delete g_world;
+    delete g_pool;
     if (g_script != NULL) delete g_script;
     
     return 0;
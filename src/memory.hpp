@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef MEMORY_HPP__INCLUDED
+#define MEMORY_HPP__INCLUDED
+
+#include <cstddef>
+
+
+/// Alignment of all SIMD-accessed buffers, one cache line
+static const size_t simd_alignment = 64;
+
+/// Allocate `size' bytes aligned to `alignment' (a power of two).
+/// Returns NULL on failure. Free with aligned_free().
+void* aligned_malloc(size_t size, size_t alignment);
+void aligned_free(void *ptr);
+
+/// Size of a transparent huge page on x86-64
+static const size_t huge_page_size = 2 * 1024 * 1024;
+
+/// Allocate `size' bytes aligned to huge_page_size and ask the OS to
+/// back them with huge pages where it can. Returns NULL on failure.
+/// Free with aligned_free().
+void* huge_page_malloc(size_t size);
+
+#endif // MEMORY_HPP__INCLUDED
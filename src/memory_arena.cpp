@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <cstring>
+#include <new>
+
+#include "memory.hpp"
+#include "memory_arena.hpp"
+
+
+MemoryArena::MemoryArena(size_t capacity)
+    : m_block(NULL)
+    , m_capacity(capacity)
+    , m_used(0)
+    , m_huge_pages(capacity >= huge_page_size)
+{
+    if (m_huge_pages)
+        m_block = (char*)huge_page_malloc(capacity);
+    else
+        m_block = (char*)aligned_malloc(capacity > 0 ? capacity : 1, simd_alignment);
+    if (m_block == NULL)
+        throw std::bad_alloc();
+    memset(m_block, 0, capacity);
+}
+
+MemoryArena::~MemoryArena()
+{
+    aligned_free(m_block);
+}
+
+size_t MemoryArena::footprint(size_t size)
+{
+    return (size + simd_alignment - 1) & ~(simd_alignment - 1);
+}
+
+void* MemoryArena::allocate(size_t size)
+{
+    size_t bytes = footprint(size);
+    if (bytes > m_capacity - m_used)
+        throw std::bad_alloc();
+    void *res = m_block + m_used;
+    m_used += bytes;
+    return res;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef MEMORY_ARENA_HPP__INCLUDED
+#define MEMORY_ARENA_HPP__INCLUDED
+
+#include <cstddef>
+
+
+/// A single aligned block of memory handed out in pieces and freed as
+/// a whole, so that all buffers of an object sit next to each other.
+///
+/// Blocks of at least huge_page_size bytes are placed on transparent
+/// huge pages where the OS supports it. The block is zeroed by the
+/// constructing thread, which also places its pages on that thread's
+/// NUMA node under a first-touch policy.
+class MemoryArena
+{
+public:
+    explicit MemoryArena(size_t capacity);
+    ~MemoryArena();
+
+    /// The next `size' bytes, aligned to simd_alignment. Throws
+    /// std::bad_alloc when the arena is exhausted.
+    void* allocate(size_t size);
+
+    size_t capacity() const { return m_capacity; }
+    size_t used() const { return m_used; }
+    bool huge_pages() const { return m_huge_pages; }
+    /// Whether `p' points into the block
+    bool owns(const void *p) const
+    {
+        return (const char*)p >= m_block && (const char*)p < m_block + m_capacity;
+    }
+
+    /// Space allocate(size) takes up in the arena
+    static size_t footprint(size_t size);
+
+private:
+    char *m_block;
+    size_t m_capacity, m_used;
+    bool m_huge_pages;
+
+    MemoryArena(const MemoryArena&);
+    MemoryArena& operator=(const MemoryArena&);
+};
+
+#endif // MEMORY_ARENA_HPP__INCLUDED
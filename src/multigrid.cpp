@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <cassert>
+#include <cmath>
+#include <new>
+
+#include "memory.hpp"
+#include "thread_pool.hpp"
+#include "multigrid.hpp"
+
+
+/// Levels are not coarsened below this many rows or columns
+static const size_t min_level_size = 3;
+
+/// Red-black iterations at each end of a level's visit, and on the
+/// coarsest level where they are cheap
+static const int smooth_iterations = 1;
+static const int coarsest_iterations = 4;
+
+SpringMultigrid::SpringMultigrid()
+    : m_fine_rows(0)
+    , m_fine_cols(0)
+{
+}
+
+SpringMultigrid::~SpringMultigrid()
+{
+    clear();
+}
+
+void SpringMultigrid::clear()
+{
+    for (size_t l = 0; l < m_levels.size(); ++l)
+    {
+        Level *level = m_levels[l];
+        level->pos.release();
+        level->orig.release();
+        aligned_free(level->invmass);
+        delete level;
+    }
+    m_levels.clear();
+    m_fine_rows = m_fine_cols = 0;
+}
+
+/// Sample positions of the `to' indices of a grid line resampled from
+/// `from' indices spanning the same extent
+void SpringMultigrid::make_samples(size_t from, size_t to, std::vector<Sample> *samples)
+{
+    assert(from >= 2 && to >= 2);
+    
+    samples->resize(to);
+    float scale = (float)(from - 1) / (float)(to - 1);
+    for (size_t k = 0; k < to; ++k)
+    {
+        float u = k * scale;
+        size_t idx = (size_t)u;
+        if (idx > from - 2)
+            idx = from - 2;
+        (*samples)[k].idx = idx;
+        (*samples)[k].frac = u - (float)idx;
+    }
+}
+
+void SpringMultigrid::build(size_t rows, size_t cols, float dist_to_left, float dist_to_bottom)
+{
+    if (rows == m_fine_rows && cols == m_fine_cols)
+        return;
+    clear();
+    size_t fine_rows = rows, fine_cols = cols;
+
+    while (rows >= 2 * min_level_size - 1 && cols >= 2 * min_level_size - 1)
+    {
+        Level *level = new Level;
+        level->rows = (rows + 1) / 2;
+        level->cols = (cols + 1) / 2;
+        // the coarse grid spans the same sheet with fewer, longer springs
+        level->dist_to_left = dist_to_left * (cols - 1) / (level->cols - 1);
+        level->dist_to_bottom = dist_to_bottom * (rows - 1) / (level->rows - 1);
+
+        size_t num_points = level->rows * level->cols;
+        level->invmass = (float*)aligned_malloc(num_points * sizeof(float), simd_alignment);
+        if (level->invmass == NULL)
+        {
+            delete level;
+            throw std::bad_alloc();
+        }
+        m_levels.push_back(level);
+        level->pos.allocate(num_points);
+        level->orig.allocate(num_points);
+
+        make_samples(rows, level->rows, &level->restrict_rows);
+        make_samples(cols, level->cols, &level->restrict_cols);
+        make_samples(level->rows, rows, &level->prolong_rows);
+        make_samples(level->cols, cols, &level->prolong_cols);
+
+        rows = level->rows;
+        cols = level->cols;
+        dist_to_left = level->dist_to_left;
+        dist_to_bottom = level->dist_to_bottom;
+    }
+
+    m_fine_rows = fine_rows;
+    m_fine_cols = fine_cols;
+}
+
+SpringGrid SpringMultigrid::level_grid(const Level &level, float stiffness)
+{
+    SpringGrid grid;
+    grid.rows = level.rows;
+    grid.cols = level.cols;
+    grid.dist_to_left = level.dist_to_left;
+    grid.dist_to_bottom = level.dist_to_bottom;
+    grid.stiffness = stiffness;
+    grid.invmass = level.invmass;
+    grid.src = grid.dst = level.pos;
+    return grid;
+}
+
+/// Sample coarse rows [i0, i1) from `fine'. A coarse point is pinned if
+/// the fine point nearest to it is, so pins hold the coarse grid too.
+void SpringMultigrid::restrict_level(const SpringGrid &fine, Level &coarse,
+                                     size_t i0, size_t i1)
+{
+    const Vec3Array &src = fine.dst;
+    
+    for (size_t i = i0; i < i1; ++i)
+    {
+        const Sample &rs = coarse.restrict_rows[i];
+        size_t nearest_i = rs.idx + (rs.frac >= 0.5f ? 1 : 0);
+        
+        for (size_t j = 0; j < coarse.cols; ++j)
+        {
+            const Sample &cs = coarse.restrict_cols[j];
+            size_t nearest_j = cs.idx + (cs.frac >= 0.5f ? 1 : 0);
+            
+            size_t a = rs.idx * fine.cols + cs.idx;
+            size_t b = a + fine.cols;
+            glm::vec3 p = glm::mix(glm::mix(src.get(a), src.get(a + 1), cs.frac),
+                                   glm::mix(src.get(b), src.get(b + 1), cs.frac),
+                                   rs.frac);
+
+            size_t idx = i * coarse.cols + j;
+            coarse.pos.set(idx, p);
+            coarse.orig.set(idx, p);
+            coarse.invmass[idx] = fine.invmass[nearest_i * fine.cols + nearest_j];
+        }
+    }
+}
+
+/// Add the interpolated coarse displacement to fine rows [i0, i1),
+/// leaving pinned points alone
+void SpringMultigrid::prolong_level(const Level &coarse, const SpringGrid &fine,
+                                    size_t i0, size_t i1)
+{
+    const Vec3Array &dst = fine.dst;
+    
+    for (size_t i = i0; i < i1; ++i)
+    {
+        const Sample &rs = coarse.prolong_rows[i];
+        
+        for (size_t j = 0; j < fine.cols; ++j)
+        {
+            size_t idx = i * fine.cols + j;
+            if (fine.invmass[idx] == 0.0f)
+                continue;
+            
+            const Sample &cs = coarse.prolong_cols[j];
+            size_t a = rs.idx * coarse.cols + cs.idx;
+            size_t b = a + coarse.cols;
+            glm::vec3 da = coarse.pos.get(a) - coarse.orig.get(a);
+            glm::vec3 da1 = coarse.pos.get(a + 1) - coarse.orig.get(a + 1);
+            glm::vec3 db = coarse.pos.get(b) - coarse.orig.get(b);
+            glm::vec3 db1 = coarse.pos.get(b + 1) - coarse.orig.get(b + 1);
+            glm::vec3 d = glm::mix(glm::mix(da, da1, cs.frac),
+                                   glm::mix(db, db1, cs.frac),
+                                   rs.frac);
+            
+            dst.set(idx, dst.get(idx) + d);
+        }
+    }
+}
+
+/// Red-black relaxation of this thread's band of `grid'; all threads are
+/// done with it on return
+void SpringMultigrid::smooth(const SpringKernels &kernels, const SpringGrid &grid,
+                             int num_iterations,
+                             size_t thread_idx, size_t num_threads, Barrier &barrier,
+                             SpringError &error)
+{
+    size_t i0, i1;
+    partition_range(grid.rows, num_threads, thread_idx, &i0, &i1);
+
+    for (int iter = 0; iter < num_iterations; ++iter)
+    {
+        for (unsigned colour = 0; colour < 2; ++colour)
+        {
+            if (i0 < i1)
+                kernels.relax_block_colour(grid, i0, i1, 0, grid.cols, colour, error);
+            barrier.wait();
+        }
+    }
+}
+
+void SpringMultigrid::cycle(const SpringKernels &kernels, const SpringGrid &upper,
+                            size_t level, size_t thread_idx, size_t num_threads,
+                            Barrier &barrier)
+{
+    Level &coarse = *m_levels[level];
+    size_t i0, i1;
+    
+    partition_range(coarse.rows, num_threads, thread_idx, &i0, &i1);
+    restrict_level(upper, coarse, i0, i1);
+    barrier.wait();
+
+    SpringGrid grid = level_grid(coarse, upper.stiffness);
+    SpringError unused;
+    if (level + 1 == m_levels.size())
+    {
+        smooth(kernels, grid, coarsest_iterations, thread_idx, num_threads, barrier, unused);
+    }
+    else
+    {
+        smooth(kernels, grid, smooth_iterations, thread_idx, num_threads, barrier, unused);
+        cycle(kernels, grid, level + 1, thread_idx, num_threads, barrier);
+        smooth(kernels, grid, smooth_iterations, thread_idx, num_threads, barrier, unused);
+    }
+
+    partition_range(upper.rows, num_threads, thread_idx, &i0, &i1);
+    prolong_level(coarse, upper, i0, i1);
+    barrier.wait();
+}
+
+void SpringMultigrid::v_cycle(const SpringKernels &kernels, const SpringGrid &fine,
+                              size_t thread_idx, size_t num_threads, Barrier &barrier,
+                              SpringError &error)
+{
+    assert(fine.src.x == fine.dst.x);
+    assert(fine.rows == m_fine_rows && fine.cols == m_fine_cols);
+    
+    smooth(kernels, fine, smooth_iterations, thread_idx, num_threads, barrier, error);
+    if (!m_levels.empty())
+        cycle(kernels, fine, 0, thread_idx, num_threads, barrier);
+    
+    SpringError unused;
+    smooth(kernels, fine, smooth_iterations, thread_idx, num_threads, barrier, unused);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef MULTIGRID_HPP__INCLUDED
+#define MULTIGRID_HPP__INCLUDED
+
+#include <vector>
+
+#include "vec3_array.hpp"
+#include "simd/springs.hpp"
+
+
+class Barrier;
+
+/// Hierarchy of coarsened copies of a spring grid, used to propagate
+/// spring corrections across large sheets within a few iterations.
+///
+/// Every level keeps every 2nd row and column of the one above. Coarse
+/// positions are sampled bilinearly from the finer level, relaxed, and
+/// the change is interpolated back onto the finer level, all in one
+/// V-cycle. Levels are smoothed with the red-black kernels in place.
+class SpringMultigrid
+{
+public:
+    SpringMultigrid();
+    ~SpringMultigrid();
+
+    /// Build the coarse levels below a rows x cols grid; does nothing if
+    /// they already match
+    void build(size_t rows, size_t cols, float dist_to_left, float dist_to_bottom);
+
+    size_t num_levels() const { return m_levels.size() + 1; }
+
+    /// Run one V-cycle over `fine' (which must have src == dst) as thread
+    /// `thread_idx' of `num_threads'. `error' gets the error measured by
+    /// the fine level pre-smoothing.
+    void v_cycle(const SpringKernels &kernels, const SpringGrid &fine,
+                 size_t thread_idx, size_t num_threads, Barrier &barrier,
+                 SpringError &error);
+
+private:
+    /// Bilinear sampling position of a coarse index in the finer grid
+    /// (for restriction) or of a fine index in the coarser grid (for
+    /// prolongation): the lower source index and the weight of the upper
+    struct Sample
+    {
+        size_t idx;
+        float frac;
+    };
+    
+    struct Level
+    {
+        size_t rows, cols;
+        float dist_to_left, dist_to_bottom;
+        Vec3Array pos, orig;
+        float *invmass;
+        // restriction from the level above, prolongation back to it
+        std::vector<Sample> restrict_rows, restrict_cols;
+        std::vector<Sample> prolong_rows, prolong_cols;
+    };
+    
+    std::vector<Level*> m_levels;
+    size_t m_fine_rows, m_fine_cols;
+
+    void clear();
+
+    static SpringGrid level_grid(const Level &level, float stiffness);
+    static void make_samples(size_t from, size_t to, std::vector<Sample> *samples);
+    
+    static void restrict_level(const SpringGrid &fine, Level &coarse, size_t i0, size_t i1);
+    static void prolong_level(const Level &coarse, const SpringGrid &fine, size_t i0, size_t i1);
+    
+    static void smooth(const SpringKernels &kernels, const SpringGrid &grid, int num_iterations,
+                       size_t thread_idx, size_t num_threads, Barrier &barrier,
+                       SpringError &error);
+
+    /// Coarse-grid correction of `upper' through m_levels[level] and below
+    void cycle(const SpringKernels &kernels, const SpringGrid &upper, size_t level,
+               size_t thread_idx, size_t num_threads, Barrier &barrier);
+};
+
+#endif // MULTIGRID_HPP__INCLUDED
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <platform.hpp>
+#ifdef PLATFORM_POSIX
+
+#include <cstdlib>
+
+#include <sys/mman.h>
+
+#include "memory.hpp"
+
+
+void* aligned_malloc(size_t size, size_t alignment)
+{
+    void *res = NULL;
+    if (posix_memalign(&res, alignment, size) != 0)
+        return NULL;
+    return res;
+}
+
+void aligned_free(void *ptr)
+{
+    free(ptr);
+}
+
+void* huge_page_malloc(size_t size)
+{
+    // round up so that the advice covers whole pages
+    size = (size + huge_page_size - 1) & ~(huge_page_size - 1);
+    void *res = aligned_malloc(size, huge_page_size);
+#ifdef MADV_HUGEPAGE
+    if (res != NULL)
+        madvise(res, size, MADV_HUGEPAGE);
+#endif
+    return res;
+}
+
+#endif // PLATFORM_POSIX
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <platform.hpp>
+#ifdef PLATFORM_POSIX
+
+#include <cassert>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "thread.hpp"
+
+
+struct MutexImpl
+{
+    pthread_mutex_t mutex;
+};
+
+struct ConditionImpl
+{
+    pthread_cond_t cond;
+};
+
+struct ThreadImpl
+{
+    pthread_t thread;
+    Thread::entry_fn entry;
+    void *arg;
+};
+
+Mutex::Mutex()
+    : m(new MutexImpl)
+{
+    pthread_mutex_init(&m->mutex, NULL);
+}
+
+Mutex::~Mutex()
+{
+    pthread_mutex_destroy(&m->mutex);
+    delete m;
+}
+
+void Mutex::lock()
+{
+    pthread_mutex_lock(&m->mutex);
+}
+
+void Mutex::unlock()
+{
+    pthread_mutex_unlock(&m->mutex);
+}
+
+Condition::Condition()
+    : m(new ConditionImpl)
+{
+    pthread_cond_init(&m->cond, NULL);
+}
+
+Condition::~Condition()
+{
+    pthread_cond_destroy(&m->cond);
+    delete m;
+}
+
+void Condition::wait(Mutex &mutex)
+{
+    pthread_cond_wait(&m->cond, &mutex.m->mutex);
+}
+
+void Condition::notify_all()
+{
+    pthread_cond_broadcast(&m->cond);
+}
+
+static void* thread_entry(void *arg)
+{
+    ThreadImpl *impl = (ThreadImpl*)arg;
+    impl->entry(impl->arg);
+    return NULL;
+}
+
+Thread::Thread(entry_fn entry, void *arg)
+    : m(new ThreadImpl)
+{
+    m->entry = entry;
+    m->arg = arg;
+    int res = pthread_create(&m->thread, NULL, &thread_entry, m);
+    assert(res == 0);
+    (void)res;
+}
+
+Thread::~Thread()
+{
+    pthread_join(m->thread, NULL);
+    delete m;
+}
+
+size_t hardware_concurrency()
+{
+    long res = sysconf(_SC_NPROCESSORS_ONLN);
+    return (res > 0) ? (size_t)res : 1;
+}
+
+#endif // PLATFORM_POSIX
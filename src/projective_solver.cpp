@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+#include "projective_solver.hpp"
+
+
+ProjectiveSolver::ProjectiveSolver(size_t rows, size_t cols,
+                                   float dist_to_left, float dist_to_bottom)
+    : m_rows(rows)
+    , m_cols(cols)
+    , m_num_points(rows * cols)
+    , m_dist_to_left(dist_to_left)
+    , m_dist_to_bottom(dist_to_bottom)
+    , m_stiffness(1e5f)
+    , m_transposed(cols > rows)
+    , m_bandwidth(std::min(rows, cols))
+    , m_factored(false)
+    , m_factored_dt(0.0f)
+    , m_invmass(NULL)
+{
+    m_factor.resize(m_num_points * (m_bandwidth + 1));
+    m_inertia.resize(m_num_points);
+    m_prediction.allocate(m_num_points);
+    m_horizontal.allocate(m_num_points);
+    m_vertical.allocate(m_num_points);
+    for (int axis = 0; axis < 3; ++axis)
+        m_rhs[axis].resize(m_num_points);
+}
+
+ProjectiveSolver::~ProjectiveSolver()
+{
+    m_prediction.release();
+    m_horizontal.release();
+    m_vertical.release();
+}
+
+void ProjectiveSolver::set_stiffness(float stiffness)
+{
+    assert(stiffness > 0.0f);
+    m_stiffness = stiffness;
+    m_factored = false;
+}
+
+/// Position of grid point `idx' in the system
+size_t ProjectiveSolver::order(size_t idx) const
+{
+    if (!m_transposed)
+        return idx;
+    size_t i = idx / m_cols, j = idx % m_cols;
+    return j * m_rows + i;
+}
+
+/// Assemble M / dt^2 + w L with the fixed points eliminated and factor
+/// it in place. Fixed points get identity rows.
+void ProjectiveSolver::factor(const float *invmass, float dt)
+{
+    double w = m_stiffness;
+    double inv_dt2 = 1.0 / ((double)dt * dt);
+    
+    std::fill(m_factor.begin(), m_factor.end(), 0.0);
+    for (size_t i = 0; i < m_rows; ++i)
+    {
+        for (size_t j = 0; j < m_cols; ++j)
+        {
+            size_t idx = i * m_cols + j;
+            size_t q = order(idx);
+            if (invmass[idx] == 0.0f)
+            {
+                m_inertia[idx] = 0.0;
+                factor_at(q, q) = 1.0;
+                continue;
+            }
+            
+            m_inertia[idx] = inv_dt2 / invmass[idx];
+            double diag = m_inertia[idx];
+            size_t neighbours[4];
+            size_t num_neighbours = 0;
+            if (i > 0)
+                neighbours[num_neighbours++] = idx - m_cols;
+            if (j > 0)
+                neighbours[num_neighbours++] = idx - 1;
+            if (j + 1 < m_cols)
+                neighbours[num_neighbours++] = idx + 1;
+            if (i + 1 < m_rows)
+                neighbours[num_neighbours++] = idx + m_cols;
+
+            for (size_t k = 0; k < num_neighbours; ++k)
+            {
+                size_t other = neighbours[k];
+                diag += w;
+                size_t p = order(other);
+                // only the lower triangle is stored; fixed neighbours
+                // go to the right hand side instead
+                if (p < q && invmass[other] != 0.0f)
+                    factor_at(q, p) = -w;
+            }
+            factor_at(q, q) = diag;
+        }
+    }
+
+    size_t n = m_num_points, b = m_bandwidth;
+    for (size_t r = 0; r < n; ++r)
+    {
+        size_t first = (r > b) ? r - b : 0;
+        for (size_t c = first; c <= r; ++c)
+        {
+            double sum = factor_at(r, c);
+            size_t k0 = std::max(first, (c > b) ? c - b : 0);
+            for (size_t k = k0; k < c; ++k)
+                sum -= factor_at(r, k) * factor_at(c, k);
+            
+            if (c == r)
+            {
+                assert(sum > 0.0);
+                factor_at(r, r) = sqrt(sum);
+            }
+            else
+            {
+                factor_at(r, c) = sum / factor_at(c, c);
+            }
+        }
+    }
+    
+    m_factored = true;
+    m_factored_dt = dt;
+}
+
+void ProjectiveSolver::prepare(const Vec3Array &pos, const float *invmass, float dt)
+{
+    if (!m_factored || dt != m_factored_dt)
+        factor(invmass, dt);
+    m_invmass = invmass;
+    m_prediction.assign(pos, m_num_points);
+}
+
+/// Projection of the spring from a to b onto the set of lengths not
+/// longer than `rest', springs only pull
+static inline glm::vec3 project_spring(const glm::vec3 &a, const glm::vec3 &b, float rest,
+                                       SpringError &error)
+{
+    glm::vec3 ab = b - a;
+    float l = glm::length(ab);
+    if (l <= rest)
+        return ab;
+
+    float stretch = (l - rest) / rest;
+    error.max = std::max(error.max, stretch);
+    error.sum_sq += stretch * stretch;
+    return ab * (rest / l);
+}
+
+void ProjectiveSolver::project(const Vec3Array &pos, size_t i0, size_t i1, SpringError &error)
+{
+    for (size_t i = i0; i < i1; ++i)
+    {
+        for (size_t j = 0; j < m_cols; ++j)
+        {
+            size_t idx = i * m_cols + j;
+            glm::vec3 p = pos.get(idx);
+            if (j + 1 < m_cols)
+                m_horizontal.set(idx, project_spring(p, pos.get(idx + 1),
+                                                     m_dist_to_left, error));
+            if (i + 1 < m_rows)
+                m_vertical.set(idx, project_spring(p, pos.get(idx + m_cols),
+                                                   m_dist_to_bottom, error));
+        }
+    }
+}
+
+static inline float component(const Vec3Array &v, int axis, size_t idx)
+{
+    const float *stream = (axis == 0) ? v.x : (axis == 1) ? v.y : v.z;
+    return stream[idx];
+}
+
+void ProjectiveSolver::solve(const Vec3Array &pos, int axis)
+{
+    assert(m_factored);
+    const float *invmass = m_invmass;
+    float *x = (axis == 0) ? pos.x : (axis == 1) ? pos.y : pos.z;
+    std::vector<double> &rhs = m_rhs[axis];
+    double w = m_stiffness;
+    
+    // right hand side, in system order
+    for (size_t i = 0; i < m_rows; ++i)
+    {
+        for (size_t j = 0; j < m_cols; ++j)
+        {
+            size_t idx = i * m_cols + j;
+            size_t q = order(idx);
+            if (invmass[idx] == 0.0f)
+            {
+                rhs[q] = x[idx];
+                continue;
+            }
+
+            double sum = m_inertia[idx] * component(m_prediction, axis, idx);
+            if (i > 0)
+            {
+                sum += w * component(m_vertical, axis, idx - m_cols);
+                if (invmass[idx - m_cols] == 0.0f)
+                    sum += w * x[idx - m_cols];
+            }
+            if (j > 0)
+            {
+                sum += w * component(m_horizontal, axis, idx - 1);
+                if (invmass[idx - 1] == 0.0f)
+                    sum += w * x[idx - 1];
+            }
+            if (j + 1 < m_cols)
+            {
+                sum -= w * component(m_horizontal, axis, idx);
+                if (invmass[idx + 1] == 0.0f)
+                    sum += w * x[idx + 1];
+            }
+            if (i + 1 < m_rows)
+            {
+                sum -= w * component(m_vertical, axis, idx);
+                if (invmass[idx + m_cols] == 0.0f)
+                    sum += w * x[idx + m_cols];
+            }
+            rhs[q] = sum;
+        }
+    }
+
+    // L y = rhs, then L^T x = y, both in place
+    size_t n = m_num_points, b = m_bandwidth;
+    for (size_t r = 0; r < n; ++r)
+    {
+        double sum = rhs[r];
+        for (size_t c = (r > b) ? r - b : 0; c < r; ++c)
+            sum -= factor_at(r, c) * rhs[c];
+        rhs[r] = sum / factor_at(r, r);
+    }
+    for (size_t r = n; r-- > 0; )
+    {
+        double sum = rhs[r];
+        size_t last = std::min(n - 1, r + b);
+        for (size_t c = r + 1; c <= last; ++c)
+            sum -= factor_at(c, r) * rhs[c];
+        rhs[r] = sum / factor_at(r, r);
+    }
+
+    for (size_t idx = 0; idx < n; ++idx)
+    {
+        if (invmass[idx] != 0.0f)
+            x[idx] = (float)rhs[order(idx)];
+    }
+}
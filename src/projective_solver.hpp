@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef PROJECTIVE_SOLVER_HPP__INCLUDED
+#define PROJECTIVE_SOLVER_HPP__INCLUDED
+
+#include <vector>
+
+#include "vec3_array.hpp"
+#include "simd/springs.hpp"
+
+
+/// Projective dynamics over the structural springs of a grid, see
+/// Bouaziz et al., "Projective Dynamics: Fusing Constraint Projections
+/// for Fast Simulation", 2014.
+///
+/// Each iteration projects every spring onto its rest length (the local
+/// step) and then solves (M / h^2 + w L) x = M / h^2 y + w S^T p for the
+/// positions (the global step), y being the inertial prediction. The
+/// matrix only depends on the topology, the masses and the time step,
+/// so its banded Cholesky factor is computed once and every iteration
+/// only does back-substitutions. Points with zero inverse mass are
+/// eliminated from the system and stay where they are.
+class ProjectiveSolver
+{
+public:
+    ProjectiveSolver(size_t rows, size_t cols, float dist_to_left, float dist_to_bottom);
+    ~ProjectiveSolver();
+
+    /// Spring weight w; the higher, the stiffer the cloth
+    void set_stiffness(float stiffness);
+    float stiffness() const { return m_stiffness; }
+    
+    /// Force refactorization, e.g. after the inverse masses change
+    void invalidate() { m_factored = false; }
+
+    /// Begin a step of length `dt' from the inertial prediction in `pos';
+    /// refactors the matrix if needed
+    void prepare(const Vec3Array &pos, const float *invmass, float dt);
+
+    /// Local step for the springs starting in rows [i0, i1)
+    void project(const Vec3Array &pos, size_t i0, size_t i1, SpringError &error);
+
+    /// Global step for one coordinate (0, 1 or 2) of `pos'. Different
+    /// coordinates may be solved concurrently.
+    void solve(const Vec3Array &pos, int axis);
+
+private:
+    size_t m_rows, m_cols, m_num_points;
+    float m_dist_to_left, m_dist_to_bottom;
+    float m_stiffness;
+
+    // The unknowns are ordered along the shorter side of the grid so
+    // that the half bandwidth is min(rows, cols).
+    bool m_transposed;
+    size_t m_bandwidth;
+    
+    bool m_factored;
+    float m_factored_dt;
+    const float *m_invmass;
+    /// Lower triangle of the Cholesky factor, m_bandwidth + 1 entries
+    /// per row ending at the diagonal
+    std::vector<double> m_factor;
+    /// Mass / dt^2 of every point, 0 for fixed points
+    std::vector<double> m_inertia;
+
+    Vec3Array m_prediction;
+    /// Projected vectors of the springs to the right and below each point
+    Vec3Array m_horizontal, m_vertical;
+    std::vector<double> m_rhs[3];
+
+    size_t order(size_t idx) const;
+    double& factor_at(size_t row, size_t col)
+    {
+        return m_factor[row * (m_bandwidth + 1) + m_bandwidth + col - row];
+    }
+    double factor_at(size_t row, size_t col) const
+    {
+        return m_factor[row * (m_bandwidth + 1) + m_bandwidth + col - row];
+    }
+    
+    void factor(const float *invmass, float dt);
+};
+
+#endif // PROJECTIVE_SOLVER_HPP__INCLUDED
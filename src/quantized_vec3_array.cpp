@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <cassert>
+
+#include "memory_arena.hpp"
+#include "quantized_vec3_array.hpp"
+
+
+static const float max_code = 65535.0f;
+
+static void decode_stream(const unsigned short *q, size_t n, float origin, float step,
+                          float *dst)
+{
+    for (size_t k = 0; k < n; ++k)
+        dst[k] = origin + q[k] * step;
+}
+
+/// Quantize one component of a block, returning its corner and step
+static void encode_stream(const float *src, size_t n, unsigned short *q,
+                          float &origin, float &step)
+{
+    float lo = src[0], hi = src[0];
+    for (size_t k = 1; k < n; ++k)
+    {
+        lo = (src[k] < lo) ? src[k] : lo;
+        hi = (src[k] > hi) ? src[k] : hi;
+    }
+
+    origin = lo;
+    step = (hi - lo) / max_code;
+    float inv_step = (step > 0.0f) ? 1.0f / step : 0.0f;
+    for (size_t k = 0; k < n; ++k)
+    {
+        float c = (src[k] - lo) * inv_step + 0.5f;
+        q[k] = (unsigned short)((c < max_code) ? c : max_code);
+    }
+}
+
+void QuantizedVec3Array::allocate(MemoryArena &arena, size_t size, size_t row_length)
+{
+    assert(x == NULL && y == NULL && z == NULL);
+    assert(row_length > 0 && size % row_length == 0);
+    this->row_length = row_length;
+    blocks_per_row = (row_length + block_size - 1) / block_size;
+
+    x = (unsigned short*)arena.allocate(size * sizeof(unsigned short));
+    y = (unsigned short*)arena.allocate(size * sizeof(unsigned short));
+    z = (unsigned short*)arena.allocate(size * sizeof(unsigned short));
+    bounds = (float*)arena.allocate(6 * (size / row_length) * blocks_per_row * sizeof(float));
+}
+
+size_t QuantizedVec3Array::arena_footprint(size_t size, size_t row_length)
+{
+    size_t num_blocks = (size / row_length) * ((row_length + block_size - 1) / block_size);
+    return 3 * MemoryArena::footprint(size * sizeof(unsigned short))
+        + MemoryArena::footprint(6 * num_blocks * sizeof(float));
+}
+
+void QuantizedVec3Array::decode_block(size_t begin, size_t n,
+                                      float *dx, float *dy, float *dz) const
+{
+    assert(n <= block_size && begin + n == block_end(begin));
+    const float *b = block_bounds(begin);
+    decode_stream(x + begin, n, b[0], b[3], dx);
+    decode_stream(y + begin, n, b[1], b[4], dy);
+    decode_stream(z + begin, n, b[2], b[5], dz);
+}
+
+void QuantizedVec3Array::encode_block(size_t begin, size_t n,
+                                      const float *sx, const float *sy, const float *sz) const
+{
+    assert(n <= block_size && begin + n == block_end(begin));
+    float *b = block_bounds(begin);
+    encode_stream(sx, n, x + begin, b[0], b[3]);
+    encode_stream(sy, n, y + begin, b[1], b[4]);
+    encode_stream(sz, n, z + begin, b[2], b[5]);
+}
+
+void QuantizedVec3Array::decode(const Vec3Array &dst, size_t begin, size_t end) const
+{
+    assert((begin % row_length) % block_size == 0 && (end == begin || block_end(end - 1) == end));
+    for (size_t idx = begin; idx < end; idx = block_end(idx))
+    {
+        size_t n = block_end(idx) - idx;
+        decode_block(idx, n, dst.x + idx, dst.y + idx, dst.z + idx);
+    }
+}
+
+void QuantizedVec3Array::encode(const Vec3Array &src, size_t begin, size_t end) const
+{
+    assert((begin % row_length) % block_size == 0 && (end == begin || block_end(end - 1) == end));
+    for (size_t idx = begin; idx < end; idx = block_end(idx))
+    {
+        size_t n = block_end(idx) - idx;
+        encode_block(idx, n, src.x + idx, src.y + idx, src.z + idx);
+    }
+}
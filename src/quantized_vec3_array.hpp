@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef QUANTIZED_VEC3_ARRAY_HPP__INCLUDED
+#define QUANTIZED_VEC3_ARRAY_HPP__INCLUDED
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "vec3_array.hpp"
+
+
+class MemoryArena;
+
+/// Compressed structure-of-arrays storage for a set of 3D vectors laid
+/// out in rows, at 16 bits per component.
+///
+/// Every row is cut into blocks of up to block_size vectors. A block
+/// keeps its bounding box, and its vectors as fixed-point offsets from
+/// the box's corner in 1/65535 of the box's extent, so the precision
+/// follows the spread of the block rather than the magnitude of the
+/// values. Blocks are always written as a whole and never straddle a
+/// row, so different threads may encode different rows.
+///
+/// Like Vec3Array it does not own its memory, which comes from an arena.
+struct QuantizedVec3Array
+{
+    static const size_t block_size = 32;
+
+    unsigned short *x, *y, *z;
+    /// Per block: the corner of the box, then the step of each axis
+    float *bounds;
+    size_t row_length, blocks_per_row;
+
+    QuantizedVec3Array()
+        : x(NULL)
+        , y(NULL)
+        , z(NULL)
+        , bounds(NULL)
+        , row_length(0)
+        , blocks_per_row(0)
+    {
+    }
+
+    void allocate(MemoryArena &arena, size_t size, size_t row_length);
+    /// Space allocate(arena, size, row_length) takes up in an arena
+    static size_t arena_footprint(size_t size, size_t row_length);
+
+    /// One past the last element of the block holding `idx'
+    size_t block_end(size_t idx) const
+    {
+        size_t j = idx % row_length;
+        size_t end = (j / block_size + 1) * block_size;
+        return idx - j + ((end < row_length) ? end : row_length);
+    }
+
+    glm::vec3 get(size_t idx) const
+    {
+        const float *b = block_bounds(idx);
+        return glm::vec3(b[0] + x[idx] * b[3],
+                         b[1] + y[idx] * b[4],
+                         b[2] + z[idx] * b[5]);
+    }
+
+    /// Decode the block starting at `begin', of `n' elements, into
+    /// float streams; begin must be the start of a block
+    void decode_block(size_t begin, size_t n, float *dx, float *dy, float *dz) const;
+    /// Replace the block starting at `begin' with `n' new elements
+    void encode_block(size_t begin, size_t n,
+                      const float *sx, const float *sy, const float *sz) const;
+
+    /// Decode or encode all elements of [begin, end), which has to
+    /// start and end on block boundaries
+    void decode(const Vec3Array &dst, size_t begin, size_t end) const;
+    void encode(const Vec3Array &src, size_t begin, size_t end) const;
+
+private:
+    float* block_bounds(size_t idx) const
+    {
+        size_t block = (idx / row_length) * blocks_per_row + (idx % row_length) / block_size;
+        return bounds + 6 * block;
+    }
+};
+
+#endif // QUANTIZED_VEC3_ARRAY_HPP__INCLUDED
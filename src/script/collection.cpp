@@ -15,6 +15,7 @@
 
 #include "lua_compat.hpp"
 #include "utils.hpp"
+#include "collider.hpp"
 #include "../world.hpp"
 
 
@@ -77,14 +78,18 @@ void collection_register(lua_State *L)
     lua_pop(L, 1);
 }
 
+/// A slot map of the world as seen from Lua. Appending moves a
+/// collider's value into the slot map; erasing copies it back to the
+/// collider, which stays usable from Lua. m_refs keeps the appended
+/// colliders, in the order of the slot map, from being collected.
 template <typename T>
 class ScriptCollection : public ScriptCollectionBase
 {
-    std::vector<T*> &m_collection;
+    SlotMap<T> &m_collection;
     std::vector<int> m_refs;
     
 public:
-    ScriptCollection(std::vector<T*> &collection)
+    ScriptCollection(SlotMap<T> &collection)
         : m_collection(collection)
     {
         assert(collection.empty());
@@ -101,9 +106,15 @@ public:
 
     virtual void append(lua_State *L)
     {
-        T *item = script_checkudata<T>(L, -1);
+        ScriptCollider<T> *collider = script_checkcollider<T>(L, -1);
+        if (collider->owner != NULL && collider->owner->valid(collider->handle))
+        {
+            luaL_error(L, "already in a collection");
+            return;
+        }
+        collider->handle = m_collection.insert(collider->value);
+        collider->owner = &m_collection;
         m_refs.push_back(luaL_ref(L, LUA_REGISTRYINDEX));
-        m_collection.push_back(item);
         
         assert(m_refs.size() == m_collection.size());
     }
@@ -120,10 +131,16 @@ public:
         }
         idx -= 1;
 
+        lua_rawgeti(L, LUA_REGISTRYINDEX, m_refs[idx]);
+        ScriptCollider<T> *collider = script_checkcollider<T>(L, -1);
+        lua_pop(L, 1);
+        collider->value = *collider->get();
+        collider->owner = NULL;
+        m_collection.erase(m_collection.handle_at(idx));
+
         // the item itself should be eventually GC'd by Lua
         luaL_unref(L, LUA_REGISTRYINDEX, m_refs[idx]);
         m_refs.erase(m_refs.begin() + idx);
-        m_collection.erase(m_collection.begin() + idx);
     }
 
     virtual void index(lua_State *L)
@@ -144,7 +161,7 @@ private:
 };
 
 template <typename T>
-void collection_new(lua_State *L, std::vector<T*> &collection)
+void collection_new(lua_State *L, SlotMap<T> &collection)
 {
     // TODO: call via lua_pcall(), pass collection as light userdata
     void *userdata = lua_newuserdata(L, sizeof(ScriptCollectionBase*));
@@ -157,5 +174,5 @@ void collection_new(lua_State *L, std::vector<T*> &collection)
 
 // instantiate templates
 
-template void collection_new<Sphere>(lua_State *L, std::vector<Sphere*> &);
-template void collection_new<Plane>(lua_State *L, std::vector<Plane*> &);
+template void collection_new<Sphere>(lua_State *L, SlotMap<Sphere> &);
+template void collection_new<Plane>(lua_State *L, SlotMap<Plane> &);
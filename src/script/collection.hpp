@@ -10,14 +10,12 @@
 #ifndef SCRIPT_COLLECTION_HPP__INCLUDED
 #define SCRIPT_COLLECTION_HPP__INCLUDED
 
-#include <vector>
-
-
 struct lua_State;
+template <typename T> class SlotMap;
 
 void collection_register(lua_State *L);
 
 template <typename T>
-void collection_new(lua_State *L, std::vector<T*> &collection);
+void collection_new(lua_State *L, SlotMap<T> &collection);
 
 #endif // SCRIPT_COLLECTION_HPP__INCLUDED
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef SCRIPT_COLLIDER_HPP__INCLUDED
+#define SCRIPT_COLLIDER_HPP__INCLUDED
+
+#include <new>
+
+#include "utils.hpp"
+#include "../slot_map.hpp"
+
+
+/// The Lua userdata of a Sphere or a Plane. A new collider lives in
+/// `value'. Once appended to a collection it lives in the collection's
+/// slot map, reached through `handle', until it is erased from there
+/// and copied back.
+template <typename T>
+struct ScriptCollider
+{
+    T value;
+    SlotMap<T> *owner;
+    typename SlotMap<T>::Handle handle;
+
+    explicit ScriptCollider(const T &value)
+        : value(value)
+        , owner(NULL)
+    {
+    }
+
+    T* get()
+    {
+        T *item = (owner != NULL) ? owner->get(handle) : NULL;
+        return (item != NULL) ? item : &value;
+    }
+};
+
+/// Push a new userdata holding `value'
+template <typename T>
+void script_pushcollider(lua_State *L, const T &value)
+{
+    void *userdata = lua_newuserdata(L, sizeof(ScriptCollider<T>));
+    luaL_getmetatable(L, ScriptTypeMetadata<T>::tname);
+    lua_setmetatable(L, -2);
+    new (userdata) ScriptCollider<T>(value);
+}
+
+template <typename T>
+ScriptCollider<T> *script_checkcollider(lua_State *L, int idx)
+{
+    return (ScriptCollider<T>*)luaL_checkudata(L, idx, ScriptTypeMetadata<T>::tname);
+}
+
+#endif // SCRIPT_COLLIDER_HPP__INCLUDED
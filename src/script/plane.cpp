@@ -13,6 +13,7 @@
 
 #include "lua_compat.hpp"
 #include "utils.hpp"
+#include "collider.hpp"
 #include "vec.hpp"
 #include "../world.hpp"
 
@@ -62,20 +63,14 @@ static int plane_new(lua_State *L)
     double c = luaL_checknumber(L, 3);
     double d = luaL_checknumber(L, 4);
 
-    void *userdata = lua_newuserdata(L, sizeof(Plane *));
-    luaL_getmetatable(L, ScriptTypeMetadata<Plane>::tname);
-    lua_setmetatable(L, -2);
-
-    Plane *plane = new Plane(glm::vec3(a, b, c), d);
-    *(Plane**)userdata = plane;
-
+    script_pushcollider(L, Plane(glm::vec3(a, b, c), d));
     return 1;
 }
 
 static int plane_gc(lua_State *L)
 {
-    Plane *plane = script_checkudata<Plane>(L, 1);
-    delete plane;
+    ScriptCollider<Plane> *collider = script_checkcollider<Plane>(L, 1);
+    collider->~ScriptCollider<Plane>();
     
     return 0;
 }
@@ -83,7 +78,7 @@ static int plane_gc(lua_State *L)
 /// Plane.mt.__index(plane, key)
 static int plane_index(lua_State *L)
 {
-    Plane *plane = script_checkudata<Plane>(L, 1);
+    Plane *plane = script_checkcollider<Plane>(L, 1)->get();
     const char *field = luaL_checkstring(L, 2);
 
     // fields
@@ -106,7 +101,7 @@ static int plane_index(lua_State *L)
 
 static int plane_newindex(lua_State *L)
 {
-    Plane *plane = script_checkudata<Plane>(L, 1);
+    Plane *plane = script_checkcollider<Plane>(L, 1)->get();
     const char *field = luaL_checkstring(L, 2);
     double value = luaL_checknumber(L, 3);
 
@@ -126,7 +121,7 @@ static int plane_newindex(lua_State *L)
 
 static int plane_tostring(lua_State *L)
 {
-    Plane *plane = script_checkudata<Plane>(L, 1);
+    Plane *plane = script_checkcollider<Plane>(L, 1)->get();
     lua_pushfstring(L, "Plane({%f, %f, %f}, %f)",
                     (lua_Number)plane->n.x,
                     (lua_Number)plane->n.y,
@@ -137,7 +132,7 @@ static int plane_tostring(lua_State *L)
 
 static int plane_from_triangle(lua_State *L)
 {
-    Plane *plane = script_checkudata<Plane>(L, 1);
+    Plane *plane = script_checkcollider<Plane>(L, 1)->get();
     glm::vec3 a = script_checkvec(L, 2);
     glm::vec3 b = script_checkvec(L, 3);
     glm::vec3 c = script_checkvec(L, 4);
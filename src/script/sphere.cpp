@@ -13,6 +13,7 @@
 
 #include "lua_compat.hpp"
 #include "utils.hpp"
+#include "collider.hpp"
 #include "../world.hpp"
 
 
@@ -54,20 +55,14 @@ static int sphere_new(lua_State *L)
     double z = luaL_checknumber(L, 3);
     double r = luaL_checknumber(L, 4);
 
-    void *userdata = lua_newuserdata(L, sizeof(Sphere *));
-    luaL_getmetatable(L, ScriptTypeMetadata<Sphere>::tname);
-    lua_setmetatable(L, -2);
-
-    Sphere *sphere = new Sphere(glm::vec3(x, y, z), r);
-    *(Sphere**)userdata = sphere;
-
+    script_pushcollider(L, Sphere(glm::vec3(x, y, z), r));
     return 1;
 }
 
 static int sphere_gc(lua_State *L)
 {
-    Sphere *sphere = script_checkudata<Sphere>(L, 1);
-    delete sphere;
+    ScriptCollider<Sphere> *collider = script_checkcollider<Sphere>(L, 1);
+    collider->~ScriptCollider<Sphere>();
     
     return 0;
 }
@@ -75,7 +70,7 @@ static int sphere_gc(lua_State *L)
 /// Sphere.mt.__index(sphere, key)
 static int sphere_index(lua_State *L)
 {
-    Sphere *sphere = script_checkudata<Sphere>(L, 1);
+    Sphere *sphere = script_checkcollider<Sphere>(L, 1)->get();
     const char *field = luaL_checkstring(L, 2);
 
     if (strcmp("x", field) == 0)
@@ -94,7 +89,7 @@ static int sphere_index(lua_State *L)
 
 static int sphere_newindex(lua_State *L)
 {
-    Sphere *sphere = script_checkudata<Sphere>(L, 1);
+    Sphere *sphere = script_checkcollider<Sphere>(L, 1)->get();
     const char *field = luaL_checkstring(L, 2);
     double value = luaL_checknumber(L, 3);
 
@@ -114,7 +109,7 @@ static int sphere_newindex(lua_State *L)
 
 static int sphere_tostring(lua_State *L)
 {
-    Sphere *sphere = script_checkudata<Sphere>(L, 1);
+    Sphere *sphere = script_checkcollider<Sphere>(L, 1)->get();
     lua_pushfstring(L, "Sphere({%f, %f, %f}, %f)",
                     (lua_Number)sphere->origin.x,
                     (lua_Number)sphere->origin.y,
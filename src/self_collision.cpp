@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+#include "self_collision.hpp"
+#include "spatial_hash.hpp"
+#include "thread_pool.hpp"
+#include "tile_sleep.hpp"
+
+
+SelfCollision::SelfCollision(size_t rows, size_t cols, float distance)
+    : m_rows(rows)
+    , m_cols(cols)
+    , m_num_points(rows * cols)
+    , m_distance(distance)
+    , m_inv_cell_size(0.5f / distance)
+    , m_mask(0)
+    , m_invmass(NULL)
+    , m_sleep(NULL)
+    , m_num_threads(0)
+{
+    assert(distance > 0.0f);
+
+    // at least twice as many slots as points, so that few cells share
+    // a slot
+    size_t table_size = 1;
+    while (table_size < 2 * m_num_points)
+        table_size *= 2;
+    m_mask = table_size - 1;
+
+    m_keys.resize(m_num_points);
+    m_sorted.resize(m_num_points);
+    m_sorted_x.resize(m_num_points);
+    m_sorted_y.resize(m_num_points);
+    m_sorted_z.resize(m_num_points);
+    m_slot_start.resize(table_size + 1);
+    m_delta.resize(m_num_points);
+}
+
+void SelfCollision::prepare(const Vec3Array &pos, const float *invmass, const TileSleep *sleep,
+                            size_t num_threads)
+{
+    m_pos = pos;
+    m_invmass = invmass;
+    m_sleep = sleep;
+    m_num_threads = num_threads;
+    m_counts.resize(num_threads * (m_mask + 1));
+    m_range_sums.resize(num_threads);
+}
+
+void SelfCollision::run(size_t thread_idx, size_t num_threads, Barrier &barrier)
+{
+    assert(num_threads == m_num_threads);
+    size_t num_slots = m_mask + 1;
+    size_t i0, i1;
+    partition_range(m_rows, num_threads, thread_idx, &i0, &i1);
+    size_t begin = i0 * m_cols, end = i1 * m_cols;
+
+    // count the points of the band in every slot
+    unsigned *counts = &m_counts[thread_idx * num_slots];
+    std::fill(counts, counts + num_slots, 0);
+    for (size_t idx = begin; idx < end; ++idx)
+    {
+        size_t key = spatial_hash(spatial_cell(m_pos.x[idx], m_inv_cell_size),
+                                  spatial_cell(m_pos.y[idx], m_inv_cell_size),
+                                  spatial_cell(m_pos.z[idx], m_inv_cell_size), m_mask);
+        m_keys[idx] = (unsigned)key;
+        ++counts[key];
+    }
+    barrier.wait();
+
+    // sum up a range of slots over all threads, then lay the slots out
+    // with the threads' points in thread order
+    size_t h0, h1;
+    partition_range(num_slots, num_threads, thread_idx, &h0, &h1);
+    unsigned sum = 0;
+    for (size_t h = h0; h < h1; ++h)
+    {
+        for (size_t t = 0; t < num_threads; ++t)
+            sum += m_counts[t * num_slots + h];
+    }
+    m_range_sums[thread_idx] = sum;
+    barrier.wait();
+
+    unsigned base = 0;
+    for (size_t t = 0; t < thread_idx; ++t)
+        base += m_range_sums[t];
+    for (size_t h = h0; h < h1; ++h)
+    {
+        m_slot_start[h] = base;
+        for (size_t t = 0; t < num_threads; ++t)
+        {
+            unsigned count = m_counts[t * num_slots + h];
+            m_counts[t * num_slots + h] = base;
+            base += count;
+        }
+    }
+    if (thread_idx + 1 == num_threads)
+        m_slot_start[num_slots] = (unsigned)m_num_points;
+    barrier.wait();
+
+    for (size_t idx = begin; idx < end; ++idx)
+    {
+        unsigned k = counts[m_keys[idx]]++;
+        m_sorted[k] = (unsigned)idx;
+        m_sorted_x[k] = m_pos.x[idx];
+        m_sorted_y[k] = m_pos.y[idx];
+        m_sorted_z[k] = m_pos.z[idx];
+    }
+    barrier.wait();
+
+    for (size_t idx = begin; idx < end; ++idx)
+        m_delta[idx] = repel(idx);
+    barrier.wait();
+
+    for (size_t idx = begin; idx < end; ++idx)
+    {
+        const glm::vec3 &d = m_delta[idx];
+        m_pos.x[idx] += d.x;
+        m_pos.y[idx] += d.y;
+        m_pos.z[idx] += d.z;
+    }
+}
+
+float SelfCollision::weight(size_t idx) const
+{
+    if (m_sleep != NULL &&
+        m_sleep->asleep(idx / m_cols / TileSleep::tile_size, idx % m_cols / TileSleep::tile_size))
+        return 0.0f;
+    return m_invmass[idx];
+}
+
+/// The correction of point `idx' from all points too close to it
+glm::vec3 SelfCollision::repel(size_t idx) const
+{
+    glm::vec3 correction(0.0f);
+    float w = weight(idx);
+    if (w == 0.0f)
+        return correction;
+
+    float px = m_pos.x[idx], py = m_pos.y[idx], pz = m_pos.z[idx];
+    // the cells are twice the distance large, so everything within the
+    // distance is in the 2 x 2 x 2 cells from the one of p - distance
+    int cx = spatial_cell(px - m_distance, m_inv_cell_size);
+    int cy = spatial_cell(py - m_distance, m_inv_cell_size);
+    int cz = spatial_cell(pz - m_distance, m_inv_cell_size);
+    size_t j = idx % m_cols;
+    float d2_max = m_distance * m_distance;
+
+    for (int dx = 0; dx <= 1; ++dx)
+    {
+        for (int dy = 0; dy <= 1; ++dy)
+        {
+            for (int dz = 0; dz <= 1; ++dz)
+            {
+                size_t h = spatial_hash(cx + dx, cy + dy, cz + dz, m_mask);
+                for (size_t k = m_slot_start[h]; k < m_slot_start[h + 1]; ++k)
+                {
+                    float vx = px - m_sorted_x[k];
+                    float vy = py - m_sorted_y[k];
+                    float vz = pz - m_sorted_z[k];
+                    float d2 = vx * vx + vy * vy + vz * vz;
+                    if (d2 >= d2_max || d2 == 0.0f)
+                        continue;
+
+                    // grid neighbours are at most a row and a column away
+                    size_t other = m_sorted[k];
+                    size_t di = (other > idx) ? other - idx : idx - other;
+                    if (di <= m_cols + 1)
+                    {
+                        size_t oj = other % m_cols;
+                        if (std::max(j, oj) - std::min(j, oj) <= 1)
+                            continue;
+                    }
+
+                    // other cells may share the slot; take each point
+                    // only from its own cell
+                    if (spatial_cell(m_sorted_x[k], m_inv_cell_size) != cx + dx ||
+                        spatial_cell(m_sorted_y[k], m_inv_cell_size) != cy + dy ||
+                        spatial_cell(m_sorted_z[k], m_inv_cell_size) != cz + dz)
+                        continue;
+
+                    float d = sqrtf(d2);
+                    float s = (m_distance - d) / d * (w / (w + weight(other)));
+                    correction += glm::vec3(vx, vy, vz) * s;
+                }
+            }
+        }
+    }
+    return correction;
+}
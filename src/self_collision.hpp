@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef SELF_COLLISION_HPP__INCLUDED
+#define SELF_COLLISION_HPP__INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vec3_array.hpp"
+
+
+class Barrier;
+class TileSleep;
+
+/// Point-point self-collision of a rows x cols grid of points.
+///
+/// Each step the points are binned into a hash table of cubic cells
+/// twice as large as the repulsion distance, by a counting sort that
+/// every thread takes a part of. A point then finds everything within
+/// the distance in the 8 cells around it. Two points closer than the
+/// distance are pushed apart along the line between them, shared by
+/// their inverse masses, unless they are neighbours on the grid. All
+/// corrections are gathered before any is applied, so the result
+/// doesn't depend on the number of threads.
+class SelfCollision
+{
+public:
+    SelfCollision(size_t rows, size_t cols, float distance);
+
+    float distance() const { return m_distance; }
+
+    /// Get ready for a step over `pos' by `num_threads' threads. Points
+    /// with zero inverse mass or in sleeping tiles aren't moved.
+    void prepare(const Vec3Array &pos, const float *invmass, const TileSleep *sleep,
+                 size_t num_threads);
+
+    /// Bin the points, then push apart the ones too close; called by
+    /// every thread of a ParallelTask. Thread `thread_idx' moves rows
+    /// [i0, i1) as given by partition_range().
+    void run(size_t thread_idx, size_t num_threads, Barrier &barrier);
+
+private:
+    size_t m_rows, m_cols, m_num_points;
+    float m_distance, m_inv_cell_size;
+    size_t m_mask;
+
+    Vec3Array m_pos;
+    const float *m_invmass;
+    const TileSleep *m_sleep;
+    size_t m_num_threads;
+
+    /// The slot of each point
+    std::vector<unsigned> m_keys;
+    /// Points sorted by slot; slot h holds m_sorted[m_slot_start[h] ..
+    /// m_slot_start[h + 1]). Their positions are copied in the same
+    /// order, so the points of a slot are read in one go.
+    std::vector<unsigned> m_sorted;
+    std::vector<float> m_sorted_x, m_sorted_y, m_sorted_z;
+    std::vector<unsigned> m_slot_start;
+    /// Per thread and slot, the number of the thread's points in the
+    /// slot, then where the thread places the next of them
+    std::vector<unsigned> m_counts;
+    /// Points counted by the slot range of each thread
+    std::vector<unsigned> m_range_sums;
+    std::vector<glm::vec3> m_delta;
+
+    float weight(size_t idx) const;
+    glm::vec3 repel(size_t idx) const;
+};
+
+#endif // SELF_COLLISION_HPP__INCLUDED
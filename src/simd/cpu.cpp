@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <platform.hpp>
+
+#ifdef CLOTH_SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif // CLOTH_SIMD_X86
+
+#include "cpu.hpp"
+
+
+#ifdef CLOTH_SIMD_X86
+
+static void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4])
+{
+#ifdef _MSC_VER
+    int tmp[4];
+    __cpuidex(tmp, leaf, subleaf);
+    for (int i = 0; i < 4; ++i)
+        regs[i] = (unsigned)tmp[i];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+/// Read XCR0, the mask of register states the OS saves on context switch
+static unsigned long long xgetbv0()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned lo, hi;
+    __asm__ __volatile__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+
+static CpuFeatures detect()
+{
+    CpuFeatures res = { false, false, false };
+    unsigned regs[4];
+
+    cpuid(0, 0, regs);
+    unsigned max_leaf = regs[0];
+    if (max_leaf < 1)
+        return res;
+
+    cpuid(1, 0, regs);
+    unsigned ecx1 = regs[2], edx1 = regs[3];
+    res.sse2 = (edx1 & (1u << 26)) != 0;
+
+    bool osxsave = (ecx1 & (1u << 27)) != 0;
+    bool avx = (ecx1 & (1u << 28)) != 0;
+    bool fma = (ecx1 & (1u << 12)) != 0;
+    if (!osxsave || !avx || max_leaf < 7)
+        return res;
+
+    unsigned long long xcr0 = xgetbv0();
+    bool ymm_state = (xcr0 & 0x06) == 0x06;
+    bool zmm_state = (xcr0 & 0xe6) == 0xe6;
+
+    cpuid(7, 0, regs);
+    unsigned ebx7 = regs[1];
+    res.avx2 = ymm_state && fma && (ebx7 & (1u << 5)) != 0;
+    res.avx512f = zmm_state && (ebx7 & (1u << 16)) != 0;
+
+    return res;
+}
+
+#else // CLOTH_SIMD_X86
+
+static CpuFeatures detect()
+{
+    CpuFeatures res = { false, false, false };
+    return res;
+}
+
+#endif // CLOTH_SIMD_X86
+
+const CpuFeatures& cpu_features()
+{
+    static const CpuFeatures features = detect();
+    return features;
+}
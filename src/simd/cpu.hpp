@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef SIMD_CPU_HPP__INCLUDED
+#define SIMD_CPU_HPP__INCLUDED
+
+
+/// Instruction set extensions usable by the current process, i.e.
+/// supported by both the CPU and the OS (register state saving).
+struct CpuFeatures
+{
+    bool sse2;
+    bool avx2;    ///< AVX2 + FMA
+    bool avx512f;
+};
+
+/// Detect features on first call (via CPUID) and cache the result
+const CpuFeatures& cpu_features();
+
+#endif // SIMD_CPU_HPP__INCLUDED
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "cpu.hpp"
+#include "springs.hpp"
+
+
+/// The kernels below compute in `Real', float or double, while the
+/// grid itself always stores floats
+template <typename Real>
+static glm::detail::tvec3<Real> solve_spring(const glm::detail::tvec3<Real> &a,
+                                             const glm::detail::tvec3<Real> &b,
+                                             Real distance, Real invmass_a, Real invmass_b,
+                                             Real stiffness, SpringError &error)
+{
+    typedef glm::detail::tvec3<Real> vec3;
+    
+    Real invmass_sum = invmass_a + invmass_b;
+    if (fabs(invmass_sum) < 1e-3)
+        return vec3(Real(0));
+
+    vec3 ab = b - a;
+    Real l = sqrt(glm::dot(ab, ab));
+    Real dl = (l - distance);
+    Real delta;
+    if (l < 1e-2 || dl < Real(0))
+    {
+        delta = Real(0);
+    }
+    else
+    {
+        delta = (invmass_a * dl / (l * invmass_sum));
+
+        Real stretch = dl / distance;
+        error.max = std::max(error.max, (float)stretch);
+        error.sum_sq += stretch * stretch;
+    }
+    return stiffness * delta * ab;
+}
+
+template <typename Real>
+static inline glm::detail::tvec3<Real> load(const Vec3Array &v, size_t idx)
+{
+    return glm::detail::tvec3<Real>(v.x[idx], v.y[idx], v.z[idx]);
+}
+
+/// Relax point (i, j) against the neighbours it has. The flags are
+/// compile-time constants, so the interior instance has no boundary
+/// tests; the springs are summed in the same order in every instance.
+template <typename Real, bool PrevRow, bool PrevCol, bool NextRow, bool NextCol>
+static inline void relax_point(const SpringGrid &g, size_t i, size_t j,
+                               SpringError &error)
+{
+    typedef glm::detail::tvec3<Real> vec3;
+    
+    const float *invmass = g.invmass;
+    const Real dist_to_left = g.dist_to_left, dist_to_bottom = g.dist_to_bottom;
+    const Real stiffness = g.stiffness;
+    size_t idx = i * g.cols + j;
+    vec3 p = load<Real>(g.src, idx);
+    vec3 dx = vec3(Real(0));
+    if (PrevRow)
+        dx += solve_spring<Real>(p, load<Real>(g.src, idx - g.cols),
+                                 dist_to_bottom,
+                                 invmass[idx], invmass[idx - g.cols],
+                                 stiffness, error);
+    if (PrevCol) 
+        dx += solve_spring<Real>(p, load<Real>(g.src, idx - 1),
+                                 dist_to_left,
+                                 invmass[idx], invmass[idx - 1],
+                                 stiffness, error);
+    if (NextRow)
+        dx += solve_spring<Real>(p, load<Real>(g.src, idx + g.cols),
+                                 dist_to_bottom,
+                                 invmass[idx], invmass[idx + g.cols],
+                                 stiffness, error);
+    if (NextCol)
+        dx += solve_spring<Real>(p, load<Real>(g.src, idx + 1),
+                                 dist_to_left,
+                                 invmass[idx], invmass[idx + 1],
+                                 stiffness, error);
+
+    vec3 r = p + dx;
+    g.dst.x[idx] = (float)r.x;
+    g.dst.y[idx] = (float)r.y;
+    g.dst.z[idx] = (float)r.z;
+}
+
+/// Relax every `step'-th point of row i from j0 up to j1: the first
+/// and last column by their own instances, the rest by the interior one
+template <typename Real, bool PrevRow, bool NextRow>
+static void relax_row(const SpringGrid &g, size_t i, size_t j0, size_t j1, size_t step,
+                      SpringError &error)
+{
+    size_t last = g.cols - 1;
+    size_t j = j0;
+    if (j == 0 && j < j1)
+    {
+        relax_point<Real, PrevRow, false, NextRow, true>(g, i, j, error);
+        j += step;
+    }
+    for (; j < j1 && j < last; j += step)
+        relax_point<Real, PrevRow, true, NextRow, true>(g, i, j, error);
+    if (j == last && j < j1)
+        relax_point<Real, PrevRow, true, NextRow, false>(g, i, j, error);
+}
+
+template <typename Real>
+static void relax_row_any(const SpringGrid &g, size_t i, size_t j0, size_t j1, size_t step,
+                          SpringError &error)
+{
+    assert(g.cols >= 2);
+    
+    bool prev_row = (i > 0), next_row = (i < g.rows - 1);
+    if (prev_row && next_row)
+        relax_row<Real, true, true>(g, i, j0, j1, step, error);
+    else if (next_row)
+        relax_row<Real, false, true>(g, i, j0, j1, step, error);
+    else if (prev_row)
+        relax_row<Real, true, false>(g, i, j0, j1, step, error);
+    else
+        relax_row<Real, false, false>(g, i, j0, j1, step, error);
+}
+
+template <typename Real>
+static void relax_block_real(const SpringGrid &g,
+                             size_t i0, size_t i1, size_t j0, size_t j1,
+                             SpringError &error)
+{
+    for (size_t i = i0; i < i1; ++i)
+        relax_row_any<Real>(g, i, j0, j1, 1, error);
+}
+
+template <typename Real>
+static void relax_block_colour_real(const SpringGrid &g,
+                                    size_t i0, size_t i1, size_t j0, size_t j1,
+                                    unsigned colour, SpringError &error)
+{
+    for (size_t i = i0; i < i1; ++i)
+    {
+        // first column of the right colour in this row
+        size_t j_first = j0 + ((i + j0 + colour) & 1);
+        relax_row_any<Real>(g, i, j_first, j1, 2, error);
+    }
+}
+
+template <typename Real>
+static void integrate_stream_real(float *x, float *x_prev, size_t n,
+                                  float damping, float dt_coeff, float accel_dt2)
+{
+    for (size_t idx = 0; idx < n; ++idx)
+    {
+        Real tmp = x[idx];
+        x[idx] = (float)(tmp + ((tmp - x_prev[idx]) * damping * dt_coeff) + accel_dt2);
+        x_prev[idx] = (float)tmp;
+    }
+}
+
+void relax_block_scalar(const SpringGrid &g,
+                        size_t i0, size_t i1, size_t j0, size_t j1,
+                        SpringError &error)
+{
+    relax_block_real<float>(g, i0, i1, j0, j1, error);
+}
+
+void relax_block_colour_scalar(const SpringGrid &g,
+                               size_t i0, size_t i1, size_t j0, size_t j1,
+                               unsigned colour, SpringError &error)
+{
+    relax_block_colour_real<float>(g, i0, i1, j0, j1, colour, error);
+}
+
+void integrate_stream_scalar(float *x, float *x_prev, size_t n,
+                             float damping, float dt_coeff, float accel_dt2)
+{
+    integrate_stream_real<float>(x, x_prev, n, damping, dt_coeff, accel_dt2);
+}
+
+const SpringKernels& spring_kernels_scalar()
+{
+    static const SpringKernels kernels = {
+        "scalar", 1, &relax_block_scalar, &relax_block_colour_scalar,
+        &integrate_stream_scalar
+    };
+    return kernels;
+}
+
+const SpringKernels& spring_kernels_double()
+{
+    static const SpringKernels kernels = {
+        "double", 1, &relax_block_real<double>, &relax_block_colour_real<double>,
+        &integrate_stream_real<double>
+    };
+    return kernels;
+}
+
+static const SpringKernels& pick_best()
+{
+    const CpuFeatures &cpu = cpu_features();
+    if (cpu.avx512f && spring_kernels_avx512() != NULL)
+        return *spring_kernels_avx512();
+    else if (cpu.avx2 && spring_kernels_avx2() != NULL)
+        return *spring_kernels_avx2();
+    else if (cpu.sse2 && spring_kernels_sse2() != NULL)
+        return *spring_kernels_sse2();
+    else
+        return spring_kernels_scalar();
+}
+
+const SpringKernels& spring_kernels_best()
+{
+    // initialized once, even if cloths on several threads ask at once
+    static const SpringKernels &best = pick_best();
+    return best;
+}
+
+const SpringKernels* spring_kernels_find(const char *name)
+{
+    const CpuFeatures &cpu = cpu_features();
+    
+    if (strcmp(name, "scalar") == 0)
+        return &spring_kernels_scalar();
+    else if (strcmp(name, "double") == 0)
+        return &spring_kernels_double();
+    else if (strcmp(name, "sse2") == 0)
+        return cpu.sse2 ? spring_kernels_sse2() : NULL;
+    else if (strcmp(name, "avx2") == 0)
+        return cpu.avx2 ? spring_kernels_avx2() : NULL;
+    else if (strcmp(name, "avx512") == 0)
+        return cpu.avx512f ? spring_kernels_avx512() : NULL;
+    else
+        return NULL;
+}
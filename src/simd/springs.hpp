@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef SIMD_SPRINGS_HPP__INCLUDED
+#define SIMD_SPRINGS_HPP__INCLUDED
+
+#include <cstddef>
+
+#include "../vec3_array.hpp"
+
+
+/// A rows x cols grid of points connected to their 4 neighbours by
+/// springs, as seen by one relaxation pass: positions are read from
+/// `src' and the relaxed positions are written to `dst'. Jacobi passes
+/// need distinct buffers; red-black passes work with dst == src.
+struct SpringGrid
+{
+    size_t rows, cols;
+    float dist_to_left, dist_to_bottom;
+    float stiffness;
+    const float *invmass;
+    Vec3Array src, dst;
+};
+
+/// Constraint error measured during a relaxation pass, in terms of the
+/// relative stretch (length - rest) / rest of the springs, counted once
+/// from each end. Compressed springs count as 0 as they don't push back.
+/// Kernels add to an existing SpringError, so start from zero.
+struct SpringError
+{
+    float max;
+    double sum_sq;
+
+    SpringError() : max(0.0f), sum_sq(0.0) {}
+
+    void merge(const SpringError &other)
+    {
+        if (other.max > max)
+            max = other.max;
+        sum_sq += other.sum_sq;
+    }
+};
+
+/// Relax all points in rows [i0, i1) and columns [j0, j1), measuring
+/// the error of their springs before the update
+typedef void (*relax_block_fn)(const SpringGrid &grid,
+                               size_t i0, size_t i1, size_t j0, size_t j1,
+                               SpringError &error);
+
+/// Relax only the points with (i + j) % 2 == colour in the block.
+/// Their neighbours all have the other colour, so the pass can update
+/// the grid in place (red-black Gauss-Seidel).
+typedef void (*relax_block_colour_fn)(const SpringGrid &grid,
+                                      size_t i0, size_t i1, size_t j0, size_t j1,
+                                      unsigned colour, SpringError &error);
+
+/// Time-corrected Verlet step of one coordinate stream of `n' points
+/// in place: `x' gets the new positions, `x_prev' the old ones
+typedef void (*integrate_stream_fn)(float *x, float *x_prev, size_t n,
+                                    float damping, float dt_coeff, float accel_dt2);
+
+/// One implementation of the per-point kernels. They are all built from
+/// templates over the arithmetic type: a float or double scalar, or a
+/// packet of floats of some instruction set.
+struct SpringKernels
+{
+    const char *name;
+    size_t width;  ///< points processed at once
+    relax_block_fn relax_block;
+    relax_block_colour_fn relax_block_colour;
+    integrate_stream_fn integrate_stream;
+};
+
+/// The scalar reference implementation, always available
+const SpringKernels& spring_kernels_scalar();
+
+/// The scalar kernels computing in double precision, to check the
+/// others against; the grid still stores floats
+const SpringKernels& spring_kernels_double();
+
+/// The widest implementation supported by the running CPU
+const SpringKernels& spring_kernels_best();
+
+/// Look an implementation up by name ("scalar", "double", "sse2",
+/// "avx2", "avx512"); returns NULL if unknown or unsupported by the CPU.
+const SpringKernels* spring_kernels_find(const char *name);
+
+/// Scalar kernels, also used by the SIMD ones for boundaries and tails
+void relax_block_scalar(const SpringGrid &grid,
+                        size_t i0, size_t i1, size_t j0, size_t j1,
+                        SpringError &error);
+void relax_block_colour_scalar(const SpringGrid &grid,
+                               size_t i0, size_t i1, size_t j0, size_t j1,
+                               unsigned colour, SpringError &error);
+void integrate_stream_scalar(float *x, float *x_prev, size_t n,
+                             float damping, float dt_coeff, float accel_dt2);
+
+// per-ISA tables, NULL when not compiled in
+const SpringKernels* spring_kernels_sse2();
+const SpringKernels* spring_kernels_avx2();
+const SpringKernels* spring_kernels_avx512();
+
+#endif // SIMD_SPRINGS_HPP__INCLUDED
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <platform.hpp>
+
+#include "springs.hpp"
+
+#ifdef CLOTH_SIMD_X86
+
+#include <immintrin.h>
+
+
+namespace {
+
+struct Avx2Ops
+{
+    typedef __m256 V;
+    typedef __m256 M;
+    static const size_t width = 8;
+
+    static V load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+    static V set1(float x) { return _mm256_set1_ps(x); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm256_div_ps(a, b); }
+    static V max(V a, V b) { return _mm256_max_ps(a, b); }
+    static V rsqrt_approx(V x) { return _mm256_rsqrt_ps(x); }
+    static M ge(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static M mask_and(M a, M b) { return _mm256_and_ps(a, b); }
+    static V select(M m, V v) { return _mm256_and_ps(m, v); }
+    static V blend(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+    static M lane_parity_mask(size_t parity)
+    {
+        return _mm256_castsi256_ps(parity ? _mm256_set_epi32(-1, 0, -1, 0, -1, 0, -1, 0)
+                                          : _mm256_set_epi32(0, -1, 0, -1, 0, -1, 0, -1));
+    }
+};
+
+} // namespace
+
+#include "springs_kernel.inl"
+
+const SpringKernels* spring_kernels_avx2()
+{
+    static const SpringKernels kernels = {
+        "avx2", Avx2Ops::width, &SpringKernel<Avx2Ops>::relax_block,
+        &SpringKernel<Avx2Ops>::relax_block_colour,
+        &SpringKernel<Avx2Ops>::integrate_stream
+    };
+    return &kernels;
+}
+
+#else // CLOTH_SIMD_X86
+
+const SpringKernels* spring_kernels_avx2()
+{
+    return NULL;
+}
+
+#endif // CLOTH_SIMD_X86
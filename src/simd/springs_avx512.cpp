@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <platform.hpp>
+
+#include "springs.hpp"
+
+#ifdef CLOTH_SIMD_X86
+
+#include <immintrin.h>
+
+
+namespace {
+
+struct Avx512Ops
+{
+    typedef __m512 V;
+    typedef __mmask16 M;
+    static const size_t width = 16;
+
+    static V load(const float *p) { return _mm512_loadu_ps(p); }
+    static void store(float *p, V v) { _mm512_storeu_ps(p, v); }
+    static V set1(float x) { return _mm512_set1_ps(x); }
+    static V add(V a, V b) { return _mm512_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm512_div_ps(a, b); }
+    static V max(V a, V b) { return _mm512_max_ps(a, b); }
+    static V rsqrt_approx(V x) { return _mm512_rsqrt14_ps(x); }
+    static M ge(V a, V b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static M mask_and(M a, M b) { return (M)(a & b); }
+    static V select(M m, V v) { return _mm512_maskz_mov_ps(m, v); }
+    static V blend(M m, V a, V b) { return _mm512_mask_mov_ps(b, m, a); }
+    static M lane_parity_mask(size_t parity)
+    {
+        return (M)(parity ? 0xaaaa : 0x5555);
+    }
+};
+
+} // namespace
+
+#include "springs_kernel.inl"
+
+const SpringKernels* spring_kernels_avx512()
+{
+    static const SpringKernels kernels = {
+        "avx512", Avx512Ops::width, &SpringKernel<Avx512Ops>::relax_block,
+        &SpringKernel<Avx512Ops>::relax_block_colour,
+        &SpringKernel<Avx512Ops>::integrate_stream
+    };
+    return &kernels;
+}
+
+#else // CLOTH_SIMD_X86
+
+const SpringKernels* spring_kernels_avx512()
+{
+    return NULL;
+}
+
+#endif // CLOTH_SIMD_X86
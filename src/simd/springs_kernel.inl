@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+// Generic SIMD spring relaxation, included by the per-ISA translation
+// units. `Ops' wraps the intrinsics of one instruction set:
+//
+//   typedef ... V;                 // packet of `width' floats
+//   typedef ... M;                 // comparison mask
+//   static const size_t width;
+//   load, store (unaligned), set1, add, sub, mul, div
+//   rsqrt_approx                   // refined here by a Newton step
+//   max, ge, mask_and, select      // select(m, v) is v where m, else 0
+//   blend                          // blend(m, a, b) is a where m, else b
+//   lane_parity_mask(p)            // lanes with index % 2 == p
+//
+// Everything here has internal linkage on purpose: each ISA unit gets
+// its own copy compiled with its own target flags. For the same reason
+// avoid calling inline functions with external linkage (std::min, glm)
+// from here: the linker may keep the copy built for a wider ISA.
+
+#include "springs.hpp"
+
+
+namespace {
+
+template <typename Ops>
+struct SpringKernel
+{
+    typedef typename Ops::V V;
+    typedef typename Ops::M M;
+
+    /// 1/sqrt(x) via the hardware estimate plus one Newton-Raphson step
+    static inline V rsqrt(V x)
+    {
+        V r = Ops::rsqrt_approx(x);
+        V half_x_r2 = Ops::mul(Ops::mul(Ops::set1(0.5f), x), Ops::mul(r, r));
+        return Ops::mul(r, Ops::sub(Ops::set1(1.5f), half_x_r2));
+    }
+
+    /// Per-lane constraint error accumulators
+    struct Error
+    {
+        V max, sum_sq;
+    };
+
+    /// Add the correction pulling points `a' towards their neighbours at
+    /// `b' (idx + offset) to `dx', `dy', `dz', and the relative stretch
+    /// of those springs to `err'. Same math as the scalar solve_spring(),
+    /// with the branches turned into a mask.
+    static inline void accumulate(const SpringGrid &g, size_t idx, ptrdiff_t offset,
+                                  V ax, V ay, V az, V ia, V distance, V inv_distance,
+                                  V &dx, V &dy, V &dz, Error &err)
+    {
+        size_t nidx = idx + offset;
+        V ib = Ops::load(g.invmass + nidx);
+        V invmass_sum = Ops::add(ia, ib);
+
+        V abx = Ops::sub(Ops::load(g.src.x + nidx), ax);
+        V aby = Ops::sub(Ops::load(g.src.y + nidx), ay);
+        V abz = Ops::sub(Ops::load(g.src.z + nidx), az);
+        V l2 = Ops::add(Ops::add(Ops::mul(abx, abx), Ops::mul(aby, aby)),
+                        Ops::mul(abz, abz));
+        V inv_l = rsqrt(l2);
+        V l = Ops::mul(l2, inv_l);
+        V dl = Ops::sub(l, distance);
+
+        M valid = Ops::mask_and(Ops::mask_and(Ops::ge(invmass_sum, Ops::set1(1e-3f)),
+                                              Ops::ge(l, Ops::set1(1e-2f))),
+                                Ops::ge(dl, Ops::set1(0.0f)));
+        // stiffness * invmass_a * dl / (l * invmass_sum)
+        V coeff = Ops::div(Ops::mul(Ops::mul(Ops::set1(g.stiffness), ia),
+                                    Ops::mul(dl, inv_l)),
+                           invmass_sum);
+        coeff = Ops::select(valid, coeff);
+
+        V stretch = Ops::mul(Ops::select(valid, dl), inv_distance);
+        err.max = Ops::max(err.max, stretch);
+        err.sum_sq = Ops::add(err.sum_sq, Ops::mul(stretch, stretch));
+
+        dx = Ops::add(dx, Ops::mul(coeff, abx));
+        dy = Ops::add(dy, Ops::mul(coeff, aby));
+        dz = Ops::add(dz, Ops::mul(coeff, abz));
+    }
+
+    /// Relax columns [j0, j1) of interior row i; all 4 neighbours exist.
+    /// With Coloured set only the points with (i + j) % 2 == colour are
+    /// written; the others are stored back unchanged, which is safe as
+    /// nothing else writes them during a colour pass.
+    template <bool Coloured>
+    static void relax_interior_row(const SpringGrid &g, size_t i, size_t j0, size_t j1,
+                                   unsigned colour, SpringError &error)
+    {
+        const ptrdiff_t cols = (ptrdiff_t)g.cols;
+        const V dist_to_left = Ops::set1(g.dist_to_left);
+        const V dist_to_bottom = Ops::set1(g.dist_to_bottom);
+        const V inv_dist_to_left = Ops::set1(1.0f / g.dist_to_left);
+        const V inv_dist_to_bottom = Ops::set1(1.0f / g.dist_to_bottom);
+
+        // the widths are even, so lane parity is the same for every chunk
+        const M colour_mask = Ops::lane_parity_mask((i + j0 + colour) & 1);
+
+        // in Coloured mode only the updated lanes count, so that the
+        // two colour passes measure every spring end once
+        Error err;
+        err.max = err.sum_sq = Ops::set1(0.0f);
+        
+        size_t j = j0;
+        for (; j + Ops::width <= j1; j += Ops::width)
+        {
+            size_t idx = i * g.cols + j;
+            V ax = Ops::load(g.src.x + idx);
+            V ay = Ops::load(g.src.y + idx);
+            V az = Ops::load(g.src.z + idx);
+            V ia = Ops::load(g.invmass + idx);
+            V dx = Ops::set1(0.0f), dy = dx, dz = dx;
+            Error point_err;
+            point_err.max = point_err.sum_sq = dx;
+
+            // same order as the scalar kernel
+            accumulate(g, idx, -cols, ax, ay, az, ia, dist_to_bottom, inv_dist_to_bottom,
+                       dx, dy, dz, point_err);
+            accumulate(g, idx, -1, ax, ay, az, ia, dist_to_left, inv_dist_to_left,
+                       dx, dy, dz, point_err);
+            accumulate(g, idx, cols, ax, ay, az, ia, dist_to_bottom, inv_dist_to_bottom,
+                       dx, dy, dz, point_err);
+            accumulate(g, idx, 1, ax, ay, az, ia, dist_to_left, inv_dist_to_left,
+                       dx, dy, dz, point_err);
+
+            if (Coloured)
+            {
+                point_err.max = Ops::select(colour_mask, point_err.max);
+                point_err.sum_sq = Ops::select(colour_mask, point_err.sum_sq);
+            }
+            err.max = Ops::max(err.max, point_err.max);
+            err.sum_sq = Ops::add(err.sum_sq, point_err.sum_sq);
+
+            V rx = Ops::add(ax, dx);
+            V ry = Ops::add(ay, dy);
+            V rz = Ops::add(az, dz);
+            if (Coloured)
+            {
+                rx = Ops::blend(colour_mask, rx, ax);
+                ry = Ops::blend(colour_mask, ry, ay);
+                rz = Ops::blend(colour_mask, rz, az);
+            }
+            Ops::store(g.dst.x + idx, rx);
+            Ops::store(g.dst.y + idx, ry);
+            Ops::store(g.dst.z + idx, rz);
+        }
+
+        float lanes_max[Ops::width], lanes_sum_sq[Ops::width];
+        Ops::store(lanes_max, err.max);
+        Ops::store(lanes_sum_sq, err.sum_sq);
+        double sum_sq = 0.0;
+        for (size_t k = 0; k < Ops::width; ++k)
+        {
+            if (lanes_max[k] > error.max)
+                error.max = lanes_max[k];
+            sum_sq += lanes_sum_sq[k];
+        }
+        error.sum_sq += sum_sq;
+
+        if (j < j1)
+            relax_scalar<Coloured>(g, i, j, j1, colour, error);
+    }
+
+    template <bool Coloured>
+    static void relax_rows(const SpringGrid &g,
+                           size_t i0, size_t i1, size_t j0, size_t j1,
+                           unsigned colour, SpringError &error)
+    {
+        for (size_t i = i0; i < i1; ++i)
+        {
+            // the first and the last row and column lack a neighbour
+            size_t jv0 = (j0 > 1) ? j0 : 1;
+            size_t jv1 = (j1 < g.cols - 1) ? j1 : g.cols - 1;
+            if (i == 0 || i == g.rows - 1 || jv0 >= jv1)
+            {
+                jv0 = jv1 = j1;
+            }
+            
+            if (j0 < jv0)
+                relax_scalar<Coloured>(g, i, j0, jv0, colour, error);
+            if (jv0 < jv1)
+                relax_interior_row<Coloured>(g, i, jv0, jv1, colour, error);
+            if (jv1 < j1)
+                relax_scalar<Coloured>(g, i, jv1, j1, colour, error);
+        }
+    }
+
+    template <bool Coloured>
+    static void relax_scalar(const SpringGrid &g, size_t i, size_t j0, size_t j1,
+                             unsigned colour, SpringError &error)
+    {
+        if (Coloured)
+            relax_block_colour_scalar(g, i, i + 1, j0, j1, colour, error);
+        else
+            relax_block_scalar(g, i, i + 1, j0, j1, error);
+    }
+
+    static void integrate_stream(float *x, float *x_prev, size_t n,
+                                 float damping, float dt_coeff, float accel_dt2)
+    {
+        const V vdamping = Ops::set1(damping);
+        const V vdt_coeff = Ops::set1(dt_coeff);
+        const V vaccel = Ops::set1(accel_dt2);
+        size_t idx = 0;
+        for (; idx + Ops::width <= n; idx += Ops::width)
+        {
+            // same order as the scalar kernel
+            V tmp = Ops::load(x + idx);
+            V v = Ops::mul(Ops::mul(Ops::sub(tmp, Ops::load(x_prev + idx)), vdamping),
+                           vdt_coeff);
+            Ops::store(x + idx, Ops::add(Ops::add(tmp, v), vaccel));
+            Ops::store(x_prev + idx, tmp);
+        }
+        if (idx < n)
+            integrate_stream_scalar(x + idx, x_prev + idx, n - idx,
+                                    damping, dt_coeff, accel_dt2);
+    }
+
+    static void relax_block(const SpringGrid &g,
+                            size_t i0, size_t i1, size_t j0, size_t j1,
+                            SpringError &error)
+    {
+        relax_rows<false>(g, i0, i1, j0, j1, 0, error);
+    }
+
+    static void relax_block_colour(const SpringGrid &g,
+                                   size_t i0, size_t i1, size_t j0, size_t j1,
+                                   unsigned colour, SpringError &error)
+    {
+        relax_rows<true>(g, i0, i1, j0, j1, colour, error);
+    }
+};
+
+} // namespace
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <platform.hpp>
+
+#include "springs.hpp"
+
+#ifdef CLOTH_SIMD_X86
+
+#include <emmintrin.h>
+
+
+namespace {
+
+struct Sse2Ops
+{
+    typedef __m128 V;
+    typedef __m128 M;
+    static const size_t width = 4;
+
+    static V load(const float *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, V v) { _mm_storeu_ps(p, v); }
+    static V set1(float x) { return _mm_set1_ps(x); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V div(V a, V b) { return _mm_div_ps(a, b); }
+    static V max(V a, V b) { return _mm_max_ps(a, b); }
+    static V rsqrt_approx(V x) { return _mm_rsqrt_ps(x); }
+    static M ge(V a, V b) { return _mm_cmpge_ps(a, b); }
+    static M mask_and(M a, M b) { return _mm_and_ps(a, b); }
+    static V select(M m, V v) { return _mm_and_ps(m, v); }
+    static V blend(M m, V a, V b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static M lane_parity_mask(size_t parity)
+    {
+        return _mm_castsi128_ps(parity ? _mm_set_epi32(-1, 0, -1, 0)
+                                       : _mm_set_epi32(0, -1, 0, -1));
+    }
+};
+
+} // namespace
+
+#include "springs_kernel.inl"
+
+const SpringKernels* spring_kernels_sse2()
+{
+    static const SpringKernels kernels = {
+        "sse2", Sse2Ops::width, &SpringKernel<Sse2Ops>::relax_block,
+        &SpringKernel<Sse2Ops>::relax_block_colour,
+        &SpringKernel<Sse2Ops>::integrate_stream
+    };
+    return &kernels;
+}
+
+#else // CLOTH_SIMD_X86
+
+const SpringKernels* spring_kernels_sse2()
+{
+    return NULL;
+}
+
+#endif // CLOTH_SIMD_X86
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef SLOT_MAP_HPP__INCLUDED
+#define SLOT_MAP_HPP__INCLUDED
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+
+/// Values stored contiguously, in insertion order, and reached from
+/// outside through handles that stay valid until the value is erased.
+///
+/// A handle names a slot, which keeps the position of its value in the
+/// dense array and a generation that is bumped whenever the slot is
+/// freed, so stale handles are detected rather than reaching whatever
+/// value took their slot over. Erasing keeps the order of the remaining
+/// values, at the cost of shifting them.
+template <typename T>
+class SlotMap
+{
+public:
+    struct Handle
+    {
+        unsigned slot, generation;
+    };
+
+    typedef typename std::vector<T>::iterator iterator;
+    typedef typename std::vector<T>::const_iterator const_iterator;
+
+    size_t size() const { return m_items.size(); }
+    bool empty() const { return m_items.empty(); }
+
+    T& operator[](size_t i) { return m_items[i]; }
+    const T& operator[](size_t i) const { return m_items[i]; }
+
+    iterator begin() { return m_items.begin(); }
+    iterator end() { return m_items.end(); }
+    const_iterator begin() const { return m_items.begin(); }
+    const_iterator end() const { return m_items.end(); }
+
+    Handle insert(const T &value)
+    {
+        unsigned slot;
+        if (m_free.empty())
+        {
+            slot = (unsigned)m_slots.size();
+            Slot s = { 0, 0 };
+            m_slots.push_back(s);
+        }
+        else
+        {
+            slot = m_free.back();
+            m_free.pop_back();
+        }
+
+        m_slots[slot].index = (unsigned)m_items.size();
+        m_items.push_back(value);
+        m_item_slots.push_back(slot);
+
+        Handle h = { slot, m_slots[slot].generation };
+        return h;
+    }
+
+    void erase(Handle h)
+    {
+        assert(valid(h));
+        size_t index = m_slots[h.slot].index;
+        m_items.erase(m_items.begin() + index);
+        m_item_slots.erase(m_item_slots.begin() + index);
+        for (size_t i = index; i < m_item_slots.size(); ++i)
+            m_slots[m_item_slots[i]].index = (unsigned)i;
+
+        ++m_slots[h.slot].generation;
+        m_free.push_back(h.slot);
+    }
+
+    bool valid(Handle h) const
+    {
+        return h.slot < m_slots.size() && m_slots[h.slot].generation == h.generation;
+    }
+
+    /// The value of `h', or NULL if it has been erased
+    T* get(Handle h)
+    {
+        return valid(h) ? &m_items[m_slots[h.slot].index] : NULL;
+    }
+
+    const T* get(Handle h) const
+    {
+        return valid(h) ? &m_items[m_slots[h.slot].index] : NULL;
+    }
+
+    /// The handle of the i-th value
+    Handle handle_at(size_t i) const
+    {
+        unsigned slot = m_item_slots[i];
+        Handle h = { slot, m_slots[slot].generation };
+        return h;
+    }
+
+private:
+    struct Slot
+    {
+        unsigned index, generation;
+    };
+
+    std::vector<T> m_items;
+    // the slot of each value
+    std::vector<unsigned> m_item_slots;
+    std::vector<Slot> m_slots;
+    std::vector<unsigned> m_free;
+};
+
+#endif // SLOT_MAP_HPP__INCLUDED
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef SPATIAL_HASH_HPP__INCLUDED
+#define SPATIAL_HASH_HPP__INCLUDED
+
+#include <cstddef>
+
+
+/// Cell coordinate of `x' in a grid of cells 1 / inv_cell_size large,
+/// clamped so that far away points can't overflow
+inline int spatial_cell(float x, float inv_cell_size)
+{
+    float c = x * inv_cell_size;
+    const float limit = 1 << 20;
+    if (!(c > -limit))
+        return -(1 << 20);
+    if (c > limit)
+        return 1 << 20;
+    // floor() without the library call
+    int i = (int)c;
+    return (c < (float)i) ? i - 1 : i;
+}
+
+/// Slot of cell (x, y, z) in a hash table of mask + 1 slots, mask + 1
+/// being a power of two
+inline size_t spatial_hash(int x, int y, int z, size_t mask)
+{
+    unsigned h = (unsigned)x * 73856093u ^ (unsigned)y * 19349663u ^ (unsigned)z * 83492791u;
+    return h & mask;
+}
+
+#endif // SPATIAL_HASH_HPP__INCLUDED
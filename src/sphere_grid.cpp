@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <algorithm>
+
+#include "sphere_grid.hpp"
+#include "spatial_hash.hpp"
+
+
+SphereGrid::SphereGrid()
+    : m_num_spheres(0)
+    , m_inv_cell_size(1.0f)
+    , m_mask(0)
+{
+}
+
+void SphereGrid::build(const ColliderTable &colliders)
+{
+    m_num_spheres = colliders.num_spheres();
+    m_oversized.clear();
+    m_entries.clear();
+
+    float sum_r = 0.0f;
+    for (size_t i = 0; i < m_num_spheres; ++i)
+        sum_r += colliders.sphere_r[i];
+    float cell_size = (m_num_spheres == 0) ? 1.0f : 2.0f * sum_r / m_num_spheres;
+    m_inv_cell_size = (cell_size > 0.0f) ? 1.0f / cell_size : 1.0f;
+
+    // the table has at least twice as many slots as binned entries
+    size_t num_entries = 0;
+    std::vector<CellRange> ranges(m_num_spheres);
+    for (size_t i = 0; i < m_num_spheres; ++i)
+    {
+        glm::vec3 origin(colliders.sphere_x[i], colliders.sphere_y[i], colliders.sphere_z[i]);
+        glm::vec3 r(colliders.sphere_r[i]);
+        ranges[i] = cell_range(origin - r, origin + r);
+        if (ranges[i].count() > max_cells_per_sphere)
+            m_oversized.push_back((unsigned)i);
+        else
+            num_entries += ranges[i].count();
+    }
+
+    size_t table_size = 1;
+    while (table_size < 2 * num_entries)
+        table_size *= 2;
+    m_mask = table_size - 1;
+    m_slot_start.assign(table_size + 1, 0);
+
+    // count the entries of every slot, then place them
+    std::vector<unsigned> cursor;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        if (pass == 1)
+        {
+            for (size_t h = 1; h <= table_size; ++h)
+                m_slot_start[h] += m_slot_start[h - 1];
+            cursor.assign(m_slot_start.begin(), m_slot_start.end() - 1);
+            m_entries.resize(num_entries);
+        }
+
+        for (size_t i = 0; i < m_num_spheres; ++i)
+        {
+            const CellRange &cr = ranges[i];
+            if (cr.count() > max_cells_per_sphere)
+                continue;
+            for (int x = cr.lo[0]; x <= cr.hi[0]; ++x)
+            {
+                for (int y = cr.lo[1]; y <= cr.hi[1]; ++y)
+                {
+                    for (int z = cr.lo[2]; z <= cr.hi[2]; ++z)
+                    {
+                        size_t h = slot(x, y, z);
+                        if (pass == 0)
+                            ++m_slot_start[h + 1];
+                        else
+                            m_entries[cursor[h]++] = (unsigned)i;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void SphereGrid::query(const glm::vec3 &lo, const glm::vec3 &hi, std::vector<unsigned> &out) const
+{
+    out.clear();
+    if (m_num_spheres == 0)
+        return;
+
+    CellRange cr = cell_range(lo, hi);
+    if (cr.count() > m_mask + 1)
+    {
+        // visiting the cells would take longer than taking every sphere
+        for (size_t i = 0; i < m_num_spheres; ++i)
+            out.push_back((unsigned)i);
+        return;
+    }
+
+    out.assign(m_oversized.begin(), m_oversized.end());
+    for (int x = cr.lo[0]; x <= cr.hi[0]; ++x)
+    {
+        for (int y = cr.lo[1]; y <= cr.hi[1]; ++y)
+        {
+            for (int z = cr.lo[2]; z <= cr.hi[2]; ++z)
+            {
+                size_t h = slot(x, y, z);
+                out.insert(out.end(), m_entries.begin() + m_slot_start[h],
+                           m_entries.begin() + m_slot_start[h + 1]);
+            }
+        }
+    }
+    // a sphere is listed in every cell it spans, and distinct cells
+    // may share a slot
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+SphereGrid::CellRange SphereGrid::cell_range(const glm::vec3 &lo, const glm::vec3 &hi) const
+{
+    CellRange cr;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        cr.lo[axis] = spatial_cell(lo[axis], m_inv_cell_size);
+        cr.hi[axis] = spatial_cell(hi[axis], m_inv_cell_size);
+    }
+    return cr;
+}
+
+size_t SphereGrid::slot(int x, int y, int z) const
+{
+    return spatial_hash(x, y, z, m_mask);
+}
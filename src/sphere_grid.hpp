@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef SPHERE_GRID_HPP__INCLUDED
+#define SPHERE_GRID_HPP__INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "collider_table.hpp"
+
+
+/// Broadphase for the spheres of a ColliderTable: a uniform grid of cubic
+/// cells, hashed into a table, each cell listing the spheres whose
+/// bounding box reaches into it.
+///
+/// The cells are as large as the mean sphere diameter. Spheres that
+/// would span more than max_cells_per_sphere cells are not binned and
+/// come with every query instead. The table is rebuilt from scratch by
+/// build(); queries are const and may run from several threads.
+class SphereGrid
+{
+public:
+    static const size_t max_cells_per_sphere = 64;
+
+    SphereGrid();
+
+    /// Bin the spheres of `colliders'
+    void build(const ColliderTable &colliders);
+
+    /// Replace `out' with the indices of the spheres that may overlap
+    /// the box [lo, hi], in ascending order and without repetitions
+    void query(const glm::vec3 &lo, const glm::vec3 &hi, std::vector<unsigned> &out) const;
+
+private:
+    struct CellRange
+    {
+        int lo[3], hi[3];
+
+        size_t count() const
+        {
+            return (size_t)(hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) * (hi[2] - lo[2] + 1);
+        }
+    };
+
+    size_t m_num_spheres;
+    float m_inv_cell_size;
+    size_t m_mask;
+    /// Entries of slot h are m_entries[m_slot_start[h] .. m_slot_start[h + 1])
+    std::vector<unsigned> m_slot_start;
+    std::vector<unsigned> m_entries;
+    std::vector<unsigned> m_oversized;
+
+    CellRange cell_range(const glm::vec3 &lo, const glm::vec3 &hi) const;
+    size_t slot(int x, int y, int z) const;
+};
+
+#endif // SPHERE_GRID_HPP__INCLUDED
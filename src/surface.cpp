@@ -10,6 +10,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
+#include <new>
 
 #include <GL/glew.h>
 #include <GL/gl.h>
@@ -17,8 +18,9 @@
 #include "surface.hpp"
 
 
-Surface::Surface(size_t rows, size_t cols)
-    : m_locked(false)
+Surface::Surface(size_t rows, size_t cols, void *storage)
+    : m_owns_points(storage == NULL)
+    , m_locked(false)
     , m_rows(rows)
     , m_cols(cols)
 {
@@ -29,7 +31,10 @@ Surface::Surface(size_t rows, size_t cols)
     glGenBuffersARB(1, &m_index_buffer);
 
     m_num_points = rows * cols;
-    m_points = new Point[m_num_points];
+    if (m_owns_points)
+        m_points = new Point[m_num_points];
+    else
+        m_points = new (storage) Point[m_num_points];
     memset(m_points, m_num_points * sizeof(m_points[0]), 0);
 
     gen_indices();
@@ -40,6 +45,13 @@ Surface::~Surface()
 {
     glDeleteBuffersARB(1, &m_vertex_buffer);
     glDeleteBuffersARB(1, &m_index_buffer);
+    if (m_owns_points)
+        delete[] m_points;
+}
+
+size_t Surface::storage_size(size_t rows, size_t cols)
+{
+    return rows * cols * sizeof(Point);
 }
 
 void Surface::lock()
@@ -16,9 +16,13 @@
 class Surface
 {
 public:
-    Surface(size_t rows, size_t cols);
+    /// Keeps the vertices in `storage' of storage_size(rows, cols) bytes
+    /// if given, which must outlive the surface
+    Surface(size_t rows, size_t cols, void *storage = NULL);
     ~Surface();
 
+    static size_t storage_size(size_t rows, size_t cols);
+
     void lock();
     void unlock();
 
@@ -39,6 +43,7 @@ private:
     };
 
     Point *m_points;
+    bool m_owns_points;
     unsigned int m_vertex_buffer, m_index_buffer;
     bool m_locked;
     size_t m_rows, m_cols;
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef THREAD_HPP__INCLUDED
+#define THREAD_HPP__INCLUDED
+
+#include <cstddef>
+
+
+// Minimal portable threading primitives; see posix_thread.cpp and
+// w32_thread.cpp for the implementations.
+
+struct MutexImpl;
+struct ConditionImpl;
+struct ThreadImpl;
+
+class Mutex
+{
+    MutexImpl *m;
+    friend class Condition;
+    
+public:
+    Mutex();
+    ~Mutex();
+
+    void lock();
+    void unlock();
+
+private:
+    Mutex(const Mutex &);
+    Mutex& operator=(const Mutex &);
+};
+
+/// Scoped lock of a Mutex
+class MutexLock
+{
+    Mutex &m_mutex;
+    
+public:
+    explicit MutexLock(Mutex &mutex) : m_mutex(mutex) { m_mutex.lock(); }
+    ~MutexLock() { m_mutex.unlock(); }
+
+private:
+    MutexLock(const MutexLock &);
+    MutexLock& operator=(const MutexLock &);
+};
+
+class Condition
+{
+    ConditionImpl *m;
+    
+public:
+    Condition();
+    ~Condition();
+
+    /// Atomically unlock `mutex' and wait; `mutex' is locked again on return
+    void wait(Mutex &mutex);
+    void notify_all();
+
+private:
+    Condition(const Condition &);
+    Condition& operator=(const Condition &);
+};
+
+class Thread
+{
+    ThreadImpl *m;
+    
+public:
+    typedef void (*entry_fn)(void *arg);
+
+    /// Start running entry(arg) in a new thread
+    Thread(entry_fn entry, void *arg);
+    /// Joins the thread
+    ~Thread();
+
+private:
+    Thread(const Thread &);
+    Thread& operator=(const Thread &);
+};
+
+/// Number of hardware threads available to the process
+size_t hardware_concurrency();
+
+#endif // THREAD_HPP__INCLUDED
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <cassert>
+#include <algorithm>
+#include <deque>
+
+#include "thread_pool.hpp"
+
+
+Barrier::Barrier(size_t num_threads)
+    : m_num_threads(num_threads)
+    , m_num_waiting(0)
+    , m_generation(0)
+{
+    assert(num_threads >= 1);
+}
+
+void Barrier::wait()
+{
+    if (m_num_threads == 1)
+        return;
+    
+    MutexLock lock(m_mutex);
+    size_t generation = m_generation;
+    if (++m_num_waiting == m_num_threads)
+    {
+        m_num_waiting = 0;
+        ++m_generation;
+        m_cond.notify_all();
+    }
+    else
+    {
+        while (generation == m_generation)
+            m_cond.wait(m_mutex);
+    }
+}
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : m_num_threads(num_threads)
+    , m_barrier(num_threads)
+    , m_task(NULL)
+    , m_generation(0)
+    , m_num_running(0)
+    , m_quit(false)
+{
+    assert(num_threads >= 1);
+
+    // thread 0 is the caller of run()
+    m_workers.resize(num_threads - 1);
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        m_workers[i].pool = this;
+        m_workers[i].idx = i + 1;
+        m_threads.push_back(new Thread(&ThreadPool::worker_entry, &m_workers[i]));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        MutexLock lock(m_mutex);
+        m_quit = true;
+        m_start_cond.notify_all();
+    }
+    
+    for (size_t i = 0; i < m_threads.size(); ++i)
+        delete m_threads[i];
+}
+
+void ThreadPool::run(ParallelTask &task)
+{
+    if (m_num_threads == 1)
+    {
+        task.run(0, 1, m_barrier);
+        return;
+    }
+    
+    {
+        MutexLock lock(m_mutex);
+        assert(m_task == NULL);
+        m_task = &task;
+        m_num_running = m_num_threads - 1;
+        ++m_generation;
+        m_start_cond.notify_all();
+    }
+
+    task.run(0, m_num_threads, m_barrier);
+
+    MutexLock lock(m_mutex);
+    while (m_num_running > 0)
+        m_done_cond.wait(m_mutex);
+    m_task = NULL;
+}
+
+namespace {
+
+/// Orders jobs by decreasing cost
+struct CostlierJob
+{
+    bool operator()(const Job *a, const Job *b) const
+    {
+        return a->cost() > b->cost();
+    }
+};
+
+/// Runs a batch of jobs from per-thread queues, stealing when a
+/// thread's own queue runs dry. The queues are filled before the run
+/// and nothing is added after, so a thread that finds every queue
+/// empty is done.
+class JobStealingTask : public ParallelTask
+{
+    struct Queue
+    {
+        Mutex mutex;
+        std::deque<Job*> jobs;
+    };
+
+    Queue *m_queues;
+    size_t m_num_queues;
+
+public:
+    JobStealingTask(const std::vector<Job*> &jobs, size_t num_threads)
+        : m_queues(new Queue[num_threads])
+        , m_num_queues(num_threads)
+    {
+        // longest processing time first: every queue runs its jobs
+        // from the longest, and the long jobs are spread evenly
+        std::vector<Job*> sorted(jobs);
+        std::stable_sort(sorted.begin(), sorted.end(), CostlierJob());
+        std::vector<double> load(num_threads, 0.0);
+        for (size_t k = 0; k < sorted.size(); ++k)
+        {
+            size_t q = std::min_element(load.begin(), load.end()) - load.begin();
+            m_queues[q].jobs.push_back(sorted[k]);
+            load[q] += sorted[k]->cost();
+        }
+    }
+
+    ~JobStealingTask()
+    {
+        delete[] m_queues;
+    }
+
+    virtual void run(size_t thread_idx, size_t num_threads, Barrier &)
+    {
+        assert(num_threads == m_num_queues);
+        (void)num_threads;
+        while (Job *job = next_job(thread_idx))
+            job->run();
+    }
+
+private:
+    /// The longest job of our own queue, or else the shortest one of
+    /// the next queue that has any; NULL when all are empty
+    Job* next_job(size_t thread_idx)
+    {
+        for (size_t k = 0; k < m_num_queues; ++k)
+        {
+            Queue &q = m_queues[(thread_idx + k) % m_num_queues];
+            MutexLock lock(q.mutex);
+            if (q.jobs.empty())
+                continue;
+            Job *job;
+            if (k == 0)
+            {
+                job = q.jobs.front();
+                q.jobs.pop_front();
+            }
+            else
+            {
+                job = q.jobs.back();
+                q.jobs.pop_back();
+            }
+            return job;
+        }
+        return NULL;
+    }
+
+    JobStealingTask(const JobStealingTask&);
+    JobStealingTask& operator=(const JobStealingTask&);
+};
+
+} // namespace
+
+void ThreadPool::run_jobs(const std::vector<Job*> &jobs)
+{
+    JobStealingTask task(jobs, m_num_threads);
+    run(task);
+}
+
+void ThreadPool::worker_entry(void *arg)
+{
+    Worker *worker = (Worker*)arg;
+    worker->pool->worker_loop(worker->idx);
+}
+
+void ThreadPool::worker_loop(size_t idx)
+{
+    size_t seen_generation = 0;
+    
+    for (;;)
+    {
+        ParallelTask *task;
+        {
+            MutexLock lock(m_mutex);
+            while (!m_quit && m_generation == seen_generation)
+                m_start_cond.wait(m_mutex);
+            if (m_quit)
+                return;
+            seen_generation = m_generation;
+            task = m_task;
+        }
+
+        task->run(idx, m_num_threads, m_barrier);
+
+        MutexLock lock(m_mutex);
+        if (--m_num_running == 0)
+            m_done_cond.notify_all();
+    }
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef THREAD_POOL_HPP__INCLUDED
+#define THREAD_POOL_HPP__INCLUDED
+
+#include <vector>
+
+#include "thread.hpp"
+
+
+/// Reusable barrier for a fixed number of threads
+class Barrier
+{
+    Mutex m_mutex;
+    Condition m_cond;
+    size_t m_num_threads;
+    size_t m_num_waiting;
+    size_t m_generation;
+    
+public:
+    explicit Barrier(size_t num_threads);
+
+    /// Block until all threads have called wait()
+    void wait();
+};
+
+/// Work executed by every thread of a ThreadPool::run() call
+class ParallelTask
+{
+public:
+    virtual ~ParallelTask() {}
+
+    /// `thread_idx' is in [0, num_threads); `barrier' synchronizes
+    /// all threads running this task.
+    virtual void run(size_t thread_idx, size_t num_threads, Barrier &barrier) = 0;
+};
+
+/// An independent piece of work for ThreadPool::run_jobs()
+class Job
+{
+public:
+    virtual ~Job() {}
+
+    /// Estimated run time, in any unit shared by the jobs of a batch
+    virtual double cost() const = 0;
+    virtual void run() = 0;
+};
+
+/// Persistent pool of worker threads running ParallelTasks in lockstep
+class ThreadPool
+{
+public:
+    /// `num_threads' includes the calling thread; a pool of 1 starts no
+    /// workers and runs tasks inline
+    explicit ThreadPool(size_t num_threads);
+    ~ThreadPool();
+
+    size_t size() const { return m_num_threads; }
+
+    /// Run `task' on all threads, the caller being thread 0, and return
+    /// once every thread is done with it
+    void run(ParallelTask &task);
+
+    /// Run every job of `jobs' once on one of the threads and return
+    /// once all are done. The jobs are dealt out longest first, each
+    /// to the thread with the least work so far; a thread that runs out
+    /// steals the shortest jobs left to the others.
+    void run_jobs(const std::vector<Job*> &jobs);
+
+private:
+    struct Worker
+    {
+        ThreadPool *pool;
+        size_t idx;
+    };
+    
+    size_t m_num_threads;
+    std::vector<Worker> m_workers;
+    std::vector<Thread*> m_threads;
+    Barrier m_barrier;
+
+    Mutex m_mutex;
+    Condition m_start_cond, m_done_cond;
+    ParallelTask *m_task;
+    size_t m_generation;
+    size_t m_num_running;
+    bool m_quit;
+
+    static void worker_entry(void *arg);
+    void worker_loop(size_t idx);
+
+    ThreadPool(const ThreadPool &);
+    ThreadPool& operator=(const ThreadPool &);
+};
+
+/// Split [0, n) into `num_parts' contiguous ranges of nearly equal size
+/// and return the bounds of range number `part'
+inline void partition_range(size_t n, size_t num_parts, size_t part,
+                            size_t *begin, size_t *end)
+{
+    size_t base = n / num_parts;
+    size_t extra = n % num_parts;
+    *begin = part * base + (part < extra ? part : extra);
+    *end = *begin + base + (part < extra ? 1 : 0);
+}
+
+#endif // THREAD_POOL_HPP__INCLUDED
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <cassert>
+#include <cmath>
+
+#include "tile_sleep.hpp"
+
+
+/// Whether a collider reaches more than `margin' into the box [lo, hi].
+/// Points resting on a collider's surface don't count.
+static bool collider_touches(const World &world, const glm::vec3 &lo, const glm::vec3 &hi,
+                             float margin)
+{
+    for (World::plane_array_t::const_iterator it = world.planes.begin();
+         it != world.planes.end(); ++it)
+    {
+        if (it->min_equ(lo, hi) < -margin)
+            return true;
+    }
+
+    for (World::sphere_array_t::const_iterator it = world.spheres.begin();
+         it != world.spheres.end(); ++it)
+    {
+        float r = it->r - margin;
+        if (r <= 0.0f)
+            continue;
+        if (it->box_dist2(lo, hi) < r * r)
+            return true;
+    }
+    return false;
+}
+
+TileSleep::TileSleep(size_t rows, size_t cols)
+    : m_cols(cols)
+    , m_tile_rows((rows + tile_size - 1) / tile_size)
+    , m_tile_cols((cols + tile_size - 1) / tile_size)
+    , m_num_awake(0)
+{
+    Tile tile;
+    tile.lo = tile.hi = glm::vec3(0.0f);
+    tile.motion = 0.0f;
+    tile.rest = 0;
+    tile.asleep = false;
+    m_tiles.assign(m_tile_rows * m_tile_cols, tile);
+    m_num_awake = m_tiles.size();
+
+    m_spans.resize(m_tile_rows);
+    for (size_t ti = 0; ti < m_tile_rows; ++ti)
+        update_spans(ti);
+}
+
+void TileSleep::set_motion(size_t ti, size_t tj, float motion,
+                           const glm::vec3 &lo, const glm::vec3 &hi)
+{
+    Tile &tile = m_tiles[ti * m_tile_cols + tj];
+    assert(!tile.asleep);
+    tile.motion = motion;
+    tile.lo = lo;
+    tile.hi = hi;
+}
+
+void TileSleep::settle(const World &world, float threshold, std::vector<size_t> &fell_asleep)
+{
+    for (size_t t = 0; t < m_tiles.size(); ++t)
+    {
+        Tile &tile = m_tiles[t];
+        if (!tile.asleep)
+            tile.rest = (tile.motion < threshold) ? tile.rest + 1 : 0;
+    }
+
+    // wake first, so that the tiles woken now keep their neighbours up
+    std::vector<size_t> woken;
+    for (size_t ti = 0; ti < m_tile_rows; ++ti)
+    {
+        for (size_t tj = 0; tj < m_tile_cols; ++tj)
+        {
+            if (asleep(ti, tj) && !neighbours_rest(ti, tj, threshold))
+                woken.push_back(ti * m_tile_cols + tj);
+        }
+    }
+    for (size_t k = 0; k < woken.size(); ++k)
+        wake(woken[k] / m_tile_cols, woken[k] % m_tile_cols);
+
+    for (size_t ti = 0; ti < m_tile_rows; ++ti)
+    {
+        for (size_t tj = 0; tj < m_tile_cols; ++tj)
+        {
+            const Tile &tile = m_tiles[ti * m_tile_cols + tj];
+            if (tile.asleep || tile.rest < rest_steps ||
+                !neighbours_rest(ti, tj, threshold) ||
+                collider_touches(world, tile.lo, tile.hi, threshold))
+                continue;
+            set_asleep(ti, tj, true);
+            fell_asleep.push_back(ti * m_tile_cols + tj);
+        }
+    }
+}
+
+void TileSleep::wake_touched(const World &world, float threshold)
+{
+    for (size_t t = 0; t < m_tiles.size(); ++t)
+    {
+        const Tile &tile = m_tiles[t];
+        if (tile.asleep && collider_touches(world, tile.lo, tile.hi, threshold))
+            wake(t / m_tile_cols, t % m_tile_cols);
+    }
+}
+
+void TileSleep::wake(size_t ti, size_t tj)
+{
+    Tile &tile = m_tiles[ti * m_tile_cols + tj];
+    tile.motion = 0.0f;
+    tile.rest = 0;
+    if (tile.asleep)
+        set_asleep(ti, tj, false);
+}
+
+void TileSleep::wake_all()
+{
+    if (m_num_awake == m_tiles.size())
+        return;
+    for (size_t ti = 0; ti < m_tile_rows; ++ti)
+    {
+        for (size_t tj = 0; tj < m_tile_cols; ++tj)
+            wake(ti, tj);
+    }
+}
+
+/// Whether all neighbours of a tile are asleep or moved less than the
+/// threshold
+bool TileSleep::neighbours_rest(size_t ti, size_t tj, float threshold) const
+{
+    size_t ti0 = (ti > 0) ? ti - 1 : 0, ti1 = (ti + 2 < m_tile_rows) ? ti + 2 : m_tile_rows;
+    size_t tj0 = (tj > 0) ? tj - 1 : 0, tj1 = (tj + 2 < m_tile_cols) ? tj + 2 : m_tile_cols;
+    for (size_t ni = ti0; ni < ti1; ++ni)
+    {
+        for (size_t nj = tj0; nj < tj1; ++nj)
+        {
+            const Tile &n = m_tiles[ni * m_tile_cols + nj];
+            if (!n.asleep && n.motion >= threshold)
+                return false;
+        }
+    }
+    return true;
+}
+
+void TileSleep::set_asleep(size_t ti, size_t tj, bool asleep)
+{
+    Tile &tile = m_tiles[ti * m_tile_cols + tj];
+    assert(tile.asleep != asleep);
+    tile.asleep = asleep;
+    if (asleep)
+        --m_num_awake;
+    else
+        ++m_num_awake;
+    update_spans(ti);
+}
+
+void TileSleep::update_spans(size_t ti)
+{
+    std::vector<Span> &spans = m_spans[ti];
+    spans.clear();
+    for (size_t tj = 0; tj < m_tile_cols; )
+    {
+        if (asleep(ti, tj))
+        {
+            ++tj;
+            continue;
+        }
+        Span span;
+        span.j0 = tj * tile_size;
+        while (tj < m_tile_cols && !asleep(ti, tj))
+            ++tj;
+        span.j1 = (tj * tile_size < m_cols) ? tj * tile_size : m_cols;
+        spans.push_back(span);
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef TILE_SLEEP_HPP__INCLUDED
+#define TILE_SLEEP_HPP__INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "world.hpp"
+
+
+/// Deactivation of the resting parts of a rows x cols grid of points.
+///
+/// The grid is cut into tiles of tile_size x tile_size points. After
+/// every substep the owner reports how far the points of each awake
+/// tile moved. A tile falls asleep once it has moved less than the
+/// threshold for rest_steps substeps in a row, while its 8 neighbours
+/// rest too and no collider reaches into its bounding box. Sleeping
+/// tiles are left out of the simulation until a moving neighbour or a
+/// collider wakes them up again.
+class TileSleep
+{
+public:
+    static const size_t tile_size = 32;
+    static const int rest_steps = 30;
+
+    /// Columns [j0, j1) of a run of awake tiles
+    struct Span
+    {
+        size_t j0, j1;
+    };
+
+    TileSleep(size_t rows, size_t cols);
+
+    size_t tile_rows() const { return m_tile_rows; }
+    size_t tile_cols() const { return m_tile_cols; }
+    size_t num_awake() const { return m_num_awake; }
+    size_t num_tiles() const { return m_tiles.size(); }
+    bool asleep(size_t ti, size_t tj) const { return m_tiles[ti * m_tile_cols + tj].asleep; }
+
+    /// The awake runs of columns in the row of tiles holding point row i
+    const std::vector<Span>& awake_spans(size_t i) const { return m_spans[i / tile_size]; }
+
+    /// Report the largest distance a point of awake tile (ti, tj) moved
+    /// during the last substep, and the tile's bounding box
+    void set_motion(size_t ti, size_t tj, float motion,
+                    const glm::vec3 &lo, const glm::vec3 &hi);
+
+    /// Wake the sleeping tiles next to moving ones, then put the tiles
+    /// that qualify to sleep. Their indices (ti * tile_cols + tj) are
+    /// appended to `fell_asleep'; the caller has to stop their points.
+    void settle(const World &world, float threshold, std::vector<size_t> &fell_asleep);
+
+    /// Wake the sleeping tiles a collider has reached into since
+    void wake_touched(const World &world, float threshold);
+
+    void wake(size_t ti, size_t tj);
+    void wake_all();
+
+private:
+    struct Tile
+    {
+        glm::vec3 lo, hi;
+        float motion;
+        int rest;
+        bool asleep;
+    };
+
+    size_t m_cols;
+    size_t m_tile_rows, m_tile_cols;
+    std::vector<Tile> m_tiles;
+    std::vector<std::vector<Span> > m_spans;
+    size_t m_num_awake;
+
+    bool neighbours_rest(size_t ti, size_t tj, float threshold) const;
+    void set_asleep(size_t ti, size_t tj, bool asleep);
+    void update_spans(size_t ti);
+};
+
+#endif // TILE_SLEEP_HPP__INCLUDED
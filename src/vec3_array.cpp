@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <cassert>
+#include <algorithm>
+#include <new>
+
+#include "memory.hpp"
+#include "memory_arena.hpp"
+#include "vec3_array.hpp"
+
+
+static float* alloc_stream(size_t size)
+{
+    void *res = aligned_malloc(std::max<size_t>(size, 1) * sizeof(float),
+                               simd_alignment);
+    if (res == NULL)
+        throw std::bad_alloc();
+    std::fill((float*)res, (float*)res + size, 0.0f);
+    return (float*)res;
+}
+
+void Vec3Array::allocate(size_t size)
+{
+    assert(x == NULL && y == NULL && z == NULL);
+    x = alloc_stream(size);
+    y = alloc_stream(size);
+    z = alloc_stream(size);
+}
+
+void Vec3Array::allocate(MemoryArena &arena, size_t size)
+{
+    assert(x == NULL && y == NULL && z == NULL);
+    // arena memory starts out zeroed
+    x = (float*)arena.allocate(size * sizeof(float));
+    y = (float*)arena.allocate(size * sizeof(float));
+    z = (float*)arena.allocate(size * sizeof(float));
+}
+
+size_t Vec3Array::arena_footprint(size_t size)
+{
+    return 3 * MemoryArena::footprint(size * sizeof(float));
+}
+
+void Vec3Array::release()
+{
+    aligned_free(x);
+    aligned_free(y);
+    aligned_free(z);
+    x = y = z = NULL;
+}
+
+void Vec3Array::assign(const Vec3Array &other, size_t size)
+{
+    std::copy(other.x, other.x + size, x);
+    std::copy(other.y, other.y + size, y);
+    std::copy(other.z, other.z + size, z);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#ifndef VEC3_ARRAY_HPP__INCLUDED
+#define VEC3_ARRAY_HPP__INCLUDED
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+
+class MemoryArena;
+
+/// Structure-of-arrays storage for a set of 3D vectors.
+///
+/// Each component lives in its own cache-line aligned stream so that
+/// loops over the set can work on contiguous float lanes. The struct
+/// does not own its memory; use allocate()/release() explicitly.
+/// Copying or swapping a Vec3Array only copies the stream pointers.
+struct Vec3Array
+{
+    float *x, *y, *z;
+
+    Vec3Array()
+        : x(NULL)
+        , y(NULL)
+        , z(NULL)
+    {
+    }
+
+    void allocate(size_t size);
+    void release();
+    /// Take the streams from `arena' instead; they go away with it and
+    /// must not be release()d
+    void allocate(MemoryArena &arena, size_t size);
+    /// Space allocate(arena, size) takes up in an arena
+    static size_t arena_footprint(size_t size);
+
+    /// Copy the first `size' elements of `other' into this array
+    void assign(const Vec3Array &other, size_t size);
+
+    glm::vec3 get(size_t idx) const
+    {
+        return glm::vec3(x[idx], y[idx], z[idx]);
+    }
+
+    void set(size_t idx, const glm::vec3 &v) const
+    {
+        x[idx] = v.x;
+        y[idx] = v.y;
+        z[idx] = v.z;
+    }
+};
+
+#endif // VEC3_ARRAY_HPP__INCLUDED
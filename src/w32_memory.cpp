@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <platform.hpp>
+#ifdef PLATFORM_WINDOWS
+
+#include <malloc.h>
+
+#include "memory.hpp"
+
+
+void* aligned_malloc(size_t size, size_t alignment)
+{
+    return _aligned_malloc(size, alignment);
+}
+
+void aligned_free(void *ptr)
+{
+    _aligned_free(ptr);
+}
+
+void* huge_page_malloc(size_t size)
+{
+    // large pages need the SeLockMemoryPrivilege and VirtualAlloc; make
+    // do with the alignment
+    return _aligned_malloc(size, huge_page_size);
+}
+
+#endif // PLATFORM_WINDOWS
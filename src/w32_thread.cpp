@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include <platform.hpp>
+#ifdef PLATFORM_WINDOWS
+
+#include <cassert>
+#include <windows.h>
+#include <process.h>
+
+#include "thread.hpp"
+
+
+// Condition variables need Windows Vista or newer
+
+struct MutexImpl
+{
+    CRITICAL_SECTION cs;
+};
+
+struct ConditionImpl
+{
+    CONDITION_VARIABLE cond;
+};
+
+struct ThreadImpl
+{
+    HANDLE thread;
+    Thread::entry_fn entry;
+    void *arg;
+};
+
+Mutex::Mutex()
+    : m(new MutexImpl)
+{
+    InitializeCriticalSection(&m->cs);
+}
+
+Mutex::~Mutex()
+{
+    DeleteCriticalSection(&m->cs);
+    delete m;
+}
+
+void Mutex::lock()
+{
+    EnterCriticalSection(&m->cs);
+}
+
+void Mutex::unlock()
+{
+    LeaveCriticalSection(&m->cs);
+}
+
+Condition::Condition()
+    : m(new ConditionImpl)
+{
+    InitializeConditionVariable(&m->cond);
+}
+
+Condition::~Condition()
+{
+    delete m;
+}
+
+void Condition::wait(Mutex &mutex)
+{
+    SleepConditionVariableCS(&m->cond, &mutex.m->cs, INFINITE);
+}
+
+void Condition::notify_all()
+{
+    WakeAllConditionVariable(&m->cond);
+}
+
+static unsigned __stdcall thread_entry(void *arg)
+{
+    ThreadImpl *impl = (ThreadImpl*)arg;
+    impl->entry(impl->arg);
+    return 0;
+}
+
+Thread::Thread(entry_fn entry, void *arg)
+    : m(new ThreadImpl)
+{
+    m->entry = entry;
+    m->arg = arg;
+    m->thread = (HANDLE)_beginthreadex(NULL, 0, &thread_entry, m, 0, NULL);
+    assert(m->thread != 0);
+}
+
+Thread::~Thread()
+{
+    WaitForSingleObject(m->thread, INFINITE);
+    CloseHandle(m->thread);
+    delete m;
+}
+
+size_t hardware_concurrency()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (info.dwNumberOfProcessors > 0) ? (size_t)info.dwNumberOfProcessors : 1;
+}
+
+#endif // PLATFORM_WINDOWS
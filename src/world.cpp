@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2012, Taras Shpot
+ * All rights reserved. Email: mrshpot@gmail.com
+ * 
+ * This demo is free software; you can redistribute it and/or modify
+ * it under the terms of the BSD-style license that is included in the
+ * file LICENSE.
+ */
+
+#include "world.hpp"
+#include "cloth.hpp"
+#include "thread_pool.hpp"
+
+
+namespace {
+
+class ClothStepJob : public Job
+{
+    Cloth *m_cloth;
+    float m_dt;
+    double m_cost;
+
+public:
+    ClothStepJob(Cloth &cloth, float dt)
+        : m_cloth(&cloth)
+        , m_dt(dt)
+        , m_cost(cloth.step_cost())
+    {
+    }
+
+    virtual double cost() const { return m_cost; }
+    virtual void run() { m_cloth->step(m_dt); }
+};
+
+} // namespace
+
+World::~World()
+{
+    for (size_t i = 0; i < cloths.size(); ++i)
+        delete cloths[i];
+}
+
+void World::step(ThreadPool &pool, float dt)
+{
+    update_colliders();
+
+    std::vector<ClothStepJob> steps;
+    steps.reserve(cloths.size());
+    for (size_t i = 0; i < cloths.size(); ++i)
+        steps.push_back(ClothStepJob(*cloths[i], dt));
+
+    std::vector<Job*> jobs(steps.size());
+    for (size_t i = 0; i < steps.size(); ++i)
+        jobs[i] = &steps[i];
+    pool.run_jobs(jobs);
+}
+
+void World::update_colliders()
+{
+    m_collider_table.build(*this);
+    if (m_collider_table.num_spheres() >= sphere_grid_min_spheres)
+        m_sphere_grid.build(m_collider_table);
+}
+
+const SphereGrid* World::sphere_grid() const
+{
+    return (m_collider_table.num_spheres() >= sphere_grid_min_spheres) ? &m_sphere_grid : NULL;
+}
@@ -14,6 +14,13 @@
 
 #include <glm/glm.hpp>
 
+#include "slot_map.hpp"
+#include "collider_table.hpp"
+#include "sphere_grid.hpp"
+
+
+class Cloth;
+class ThreadPool;
 
 struct Sphere
 {
@@ -25,12 +32,6 @@ struct Sphere
         , r(r)
     {
     }
-
-    Sphere(const Sphere &other)
-        : origin(other.origin)
-        , r(other.r)
-    {
-    }
     
     float equ(const glm::vec3 &x) const
     {
@@ -39,6 +40,13 @@ struct Sphere
         glm::vec3 v = x - origin;
         return glm::dot(v, v) - (r * r);
     }
+
+    /// Squared distance from the origin to the box [lo, hi]
+    float box_dist2(const glm::vec3 &lo, const glm::vec3 &hi) const
+    {
+        glm::vec3 v = glm::clamp(origin, lo, hi) - origin;
+        return glm::dot(v, v);
+    }
 };
 
 struct Plane
@@ -63,27 +71,63 @@ struct Plane
         d = -equ(p1); // should work with any point on the plane
     }
     
-    Plane(const Plane &other)
-        : n(other.n)
-        , d(other.d)
-    {
-    }
-    
     float equ(const glm::vec3 &x) const
     {
         // Equation: Ax + By + Cz + D = 0;
         // (A, B, C) (normalized) are stored in n; D is stored in d.
         return glm::dot(n, x) + d;
     }
+
+    /// The lowest value of the equation over the box [lo, hi]
+    float min_equ(const glm::vec3 &lo, const glm::vec3 &hi) const
+    {
+        glm::vec3 centre = (lo + hi) * 0.5f;
+        glm::vec3 half = (hi - lo) * 0.5f;
+        return equ(centre) - glm::dot(glm::abs(n), half);
+    }
 };
 
 struct World
 {
-    typedef std::vector<Sphere*> sphere_array_t;
-    typedef std::vector<Plane*> plane_array_t;
+    /// The colliders are owned by the world and stored by value; keep a
+    /// handle rather than a pointer, as inserting or erasing moves them
+    typedef SlotMap<Sphere> sphere_array_t;
+    typedef SlotMap<Plane> plane_array_t;
+    typedef std::vector<Cloth*> cloth_array_t;
     
     sphere_array_t spheres;
     plane_array_t planes;
+    /// Owned by the world and deleted with it. Every cloth has to be
+    /// built with this world.
+    cloth_array_t cloths;
+
+    World() {}
+    ~World();
+
+    /// Step every cloth by `dt' as an independent job of `pool', see
+    /// ThreadPool::run_jobs(), balanced by Cloth::step_cost(). The
+    /// colliders are taken by update_colliders() first and only read
+    /// meanwhile. Each cloth should be left at one thread of its own;
+    /// the pool provides the parallelism.
+    void step(ThreadPool &pool, float dt);
+
+    /// Pack the colliders for the collision passes of the cloths; call
+    /// it before stepping a cloth on its own once they have changed
+    void update_colliders();
+    const ColliderTable& collider_table() const { return m_collider_table; }
+    /// Broadphase over the spheres of collider_table(), or NULL while
+    /// there are too few of them for it to pay off
+    const SphereGrid* sphere_grid() const;
+
+private:
+    /// Below this many spheres the spheres aren't binned into a grid
+    static const size_t sphere_grid_min_spheres = 8;
+
+    ColliderTable m_collider_table;
+    SphereGrid m_sphere_grid;
+
+    World(const World&);
+    World& operator=(const World&);
 };
 
 #endif // WORLD_HPP__INCLUDED